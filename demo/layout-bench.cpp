@@ -0,0 +1,218 @@
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <SFML/Graphics/View.hpp>
+
+#include <tmap/TiledMap.hpp>
+
+#include "../src/TileMatrix.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <memory>
+
+namespace {
+
+using TileMatrix       = tmap::TileMatrix;
+using TileLayerStorage = tmap::TileLayerStorage;
+using Clock            = std::chrono::steady_clock;
+
+struct Layout {
+    const char * name;
+    TileLayerStorage storage;
+};
+
+const Layout k_layouts[] = {
+    { "row-major", TileLayerStorage::k_row_major },
+    { "blocked"  , TileLayerStorage::k_blocked   },
+    { "palette"  , TileLayerStorage::k_palette   },
+    { "run-length", TileLayerStorage::k_run_length }
+};
+
+// a tall map, to show off column heavy camera movement
+constexpr const int k_map_width  =  512;
+constexpr const int k_map_height = 4096;
+// roughly a 640x480 screen of 16x16 tiles
+constexpr const int k_view_width  = 40;
+constexpr const int k_view_height = 30;
+
+std::unique_ptr<TileMatrix> make_filled_matrix(TileLayerStorage);
+
+double time_ms(const std::function<long()> & f, long & checksum);
+
+long draw_vertical_scroll(const TileMatrix &);
+
+long draw_horizontal_scroll(const TileMatrix &);
+
+long autotile_pass(const TileMatrix &);
+
+long actor_collision_checks(const TileMatrix &);
+
+void bench_map_draw(const char * filename);
+
+} // end of <anonymous> namespace
+
+int main(int argc, char ** argv) {
+    struct Workload {
+        const char * name;
+        long (*run)(const TileMatrix &);
+    };
+    static const Workload k_workloads[] = {
+        { "draw, vertical scroll"  , draw_vertical_scroll   },
+        { "draw, horizontal scroll", draw_horizontal_scroll },
+        { "3x3 autotile pass"      , autotile_pass          },
+        { "5x5 actor collision"    , actor_collision_checks }
+    };
+
+    std::cout << "Matrix workloads on a " << k_map_width << "x" << k_map_height
+              << " layer (ms)" << std::endl;
+    std::cout << std::setw(26) << "";
+    for (const auto & layout : k_layouts)
+        std::cout << std::setw(12) << layout.name;
+    std::cout << std::endl;
+
+    std::vector<std::unique_ptr<TileMatrix>> matrices;
+    for (const auto & layout : k_layouts)
+        matrices.emplace_back(make_filled_matrix(layout.storage));
+
+    for (const auto & workload : k_workloads) {
+        std::cout << std::setw(26) << std::left << workload.name << std::right;
+        long first_checksum = 0;
+        for (std::size_t i = 0; i != matrices.size(); ++i) {
+            long checksum = 0;
+            const TileMatrix & matrix = *matrices[i];
+            double ms = time_ms([&matrix, &workload]() { return workload.run(matrix); },
+                                checksum);
+            if (i == 0) first_checksum = checksum;
+            std::cout << std::setw(12) << std::fixed << std::setprecision(2) << ms;
+            if (checksum != first_checksum)
+                std::cout << " (mismatch!)";
+        }
+        std::cout << std::endl;
+    }
+
+    if (argc > 1) bench_map_draw(argv[1]);
+}
+
+namespace {
+
+std::unique_ptr<TileMatrix> make_filled_matrix(TileLayerStorage storage) {
+    auto matrix = tmap::make_tile_matrix(storage, k_map_width, k_map_height);
+    std::mt19937 rng { 0x7A3 };
+    std::uniform_int_distribution<int> gid_distri(0, 64);
+    for (int y = 0; y != k_map_height; ++y) {
+    for (int x = 0; x != k_map_width ; ++x) {
+        matrix->set_gid(x, y, gid_distri(rng));
+    }}
+    return matrix;
+}
+
+double time_ms(const std::function<long()> & f, long & checksum) {
+    static constexpr const int k_trials = 5;
+    double best = 0.;
+    for (int i = 0; i != k_trials; ++i) {
+        auto start = Clock::now();
+        checksum = f();
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        if (i == 0 || elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+long draw_view(const TileMatrix & matrix, int left, int top, std::vector<int> & row) {
+    long sum = 0;
+    for (int y = top; y != top + k_view_height; ++y) {
+        matrix.read_row(left, y, k_view_width, row.data());
+        for (int gid : row) sum += gid;
+    }
+    return sum;
+}
+
+long draw_vertical_scroll(const TileMatrix & matrix) {
+    std::vector<int> row(k_view_width);
+    long sum = 0;
+    for (int x = 0; x + k_view_width <= k_map_width; x += k_view_width) {
+    for (int y = 0; y + k_view_height <= k_map_height; ++y) {
+        sum += draw_view(matrix, x, y, row);
+    }}
+    return sum;
+}
+
+long draw_horizontal_scroll(const TileMatrix & matrix) {
+    std::vector<int> row(k_view_width);
+    long sum = 0;
+    for (int y = 0; y + k_view_height <= k_map_height; y += k_view_height) {
+    for (int x = 0; x + k_view_width <= k_map_width; ++x) {
+        sum += draw_view(matrix, x, y, row);
+    }}
+    return sum;
+}
+
+long autotile_pass(const TileMatrix & matrix) {
+    long sum = 0;
+    for (int y = 1; y != k_map_height - 1; ++y) {
+    for (int x = 1; x != k_map_width  - 1; ++x) {
+        // a tile's shape depends on which of its neighbors match it
+        const int gid = matrix.gid_at(x, y);
+        int mask = 0;
+        for (int dy = -1; dy != 2; ++dy) {
+        for (int dx = -1; dx != 2; ++dx) {
+            mask = (mask << 1) | (matrix.gid_at(x + dx, y + dy) == gid);
+        }}
+        sum += mask;
+    }}
+    return sum;
+}
+
+long actor_collision_checks(const TileMatrix & matrix) {
+    static constexpr const int k_actor_count = 200000;
+    std::mt19937 rng { 0x5EED };
+    std::uniform_int_distribution<int> x_distri(2, k_map_width  - 3);
+    std::uniform_int_distribution<int> y_distri(2, k_map_height - 3);
+    long sum = 0;
+    for (int i = 0; i != k_actor_count; ++i) {
+        const int ax = x_distri(rng);
+        const int ay = y_distri(rng);
+        for (int y = ay - 2; y != ay + 3; ++y) {
+        for (int x = ax - 2; x != ax + 3; ++x) {
+            sum += (matrix.gid_at(x, y) > 32);
+        }}
+    }
+    return sum;
+}
+
+void bench_map_draw(const char * filename) {
+    static constexpr const int k_frames = 200;
+    std::cout << "\nDrawing \"" << filename << "\" " << k_frames
+              << " times (ms)" << std::endl;
+    sf::RenderTexture target;
+    if (!target.create(640, 480)) {
+        std::cout << "Cannot create render texture, skipping." << std::endl;
+        return;
+    }
+    for (const auto & layout : k_layouts) {
+        tmap::MapLoadOptions options;
+        options.tile_layer_storage = layout.storage;
+        tmap::TiledMap map;
+        map.load_from_file(filename, options);
+
+        long frames = 0;
+        double ms = time_ms([&]() {
+            for (int i = 0; i != k_frames; ++i) {
+                sf::View view(sf::Vector2f(320.f, 240.f + float(i)*8.f),
+                              sf::Vector2f(640.f, 480.f));
+                target.setView(view);
+                target.clear();
+                for (auto & layer : map) target.draw(*layer);
+                target.display();
+            }
+            return long(k_frames);
+        }, frames);
+        std::cout << std::setw(26) << std::left << layout.name << std::right
+                  << std::setw(12) << std::fixed << std::setprecision(2) << ms
+                  << std::endl;
+    }
+}
+
+} // end of <anonymous> namespace
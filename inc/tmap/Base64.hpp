@@ -74,4 +74,38 @@ ByteBuffer decode(const std::string & str);
  */
 ByteBuffer decode(const std::string & str, ByteBuffer & cache_data);
 
+/** Decodes base 64 text a piece at a time, into as many output buffers as the
+ *  caller likes, without copying (or cleaning) the text first. @n
+ *  Whitespace, control and non-ascii characters are skipped, as tile data in
+ *  XML is usually broken up into lines.
+ */
+class Decoder {
+public:
+    /** Decodes characters from [beg, end), until either all characters are
+     *  read or the output is full.
+     *  @param beg moved past every character read
+     *  @param out where decoded bytes are written
+     *  @param out_size most bytes which may be written
+     *  @throws if a character is not valid base 64, or is out of place
+     *  @return number of bytes written
+     */
+    std::size_t decode(const char *& beg, const char * end,
+                       UInt8 * out, std::size_t out_size);
+
+    /** Checks that all text given so far was complete base 64.
+     *  @throws if the last four character group was not finished
+     */
+    void finish() const;
+
+private:
+    // bits read, but not yet written out
+    unsigned m_bits = 0;
+    int m_bit_count = 0;
+    // characters read in the current four character group
+    int m_group_position = 0;
+    int m_padding = 0;
+    // characters read over all calls, for error messages
+    std::size_t m_position = 0;
+};
+
 } // end of Base64 namespace
@@ -0,0 +1,219 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+
+#pragma once
+
+#include <tmap/TilePropertiesInterface.hpp>
+#include <tmap/MapObject.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace tmap {
+
+/** What for_each_cell hands its callback for each cell visited. */
+struct TileCell {
+    /** position of the cell in the tile matrix (NOT pixel position) */
+    int x = 0;
+    int y = 0;
+
+    /** global id, k_no_tile for empty cells */
+    int gid = TilePropertiesInterface::k_no_tile;
+
+    /** tileset owning the gid, nullptr for empty cells (and gids which no
+     *  tileset owns)
+     */
+    const TileSetInterface * tileset = nullptr;
+
+    /** id local to the tileset, only meaningful if there is a tileset */
+    int tid = 0;
+};
+
+/** Calls a function for every cell in a rectangle of a tile layer. @n
+ *  Gids are read a row at a time, and tilesets are only looked up when the
+ *  gid leaves the range of the last one found, so the callback (which may
+ *  be inlined) is the only cost per cell.
+ *  @param func callable with signature: @n
+ *              void func(const TileCell &)
+ *  @note cells are visited row by row, cells outside of the layer are
+ *        skipped
+ */
+template <typename Func>
+void for_each_cell
+    (const TilePropertiesInterface & layer, int x, int y, int width, int height,
+     Func && func);
+
+/** Calls a function for every cell of a tile layer.
+ *  @copydetails for_each_cell(const TilePropertiesInterface&,int,int,int,int,Func&&)
+ */
+template <typename Func>
+void for_each_cell(const TilePropertiesInterface & layer, Func && func);
+
+/** Like for_each_cell, but the callback may change cells. @n
+ *  Any change the callback makes to the cell's gid is written back, rows are
+ *  written back (with TilePropertiesInterface::write_gids) after the whole
+ *  row has been visited, and only if something in them changed.
+ *  @param func callable with signature: @n
+ *              void func(TileCell &)
+ *  @throw Will throw a std::runtime_error if a new gid is not associated
+ *         with any tileset, rows already written back are kept.
+ */
+template <typename Func>
+void for_each_cell_mutable
+    (TilePropertiesInterface & layer, int x, int y, int width, int height,
+     Func && func);
+
+/** Like for_each_cell, but the callback may change cells.
+ *  @copydetails for_each_cell_mutable(TilePropertiesInterface&,int,int,int,int,Func&&)
+ */
+template <typename Func>
+void for_each_cell_mutable(TilePropertiesInterface & layer, Func && func);
+
+// ----------------------------------------------------------------------------
+
+/** Remembers the last tileset found, so that runs of gids from the same
+ *  tileset cost one range check each.
+ *  @note used by for_each_cell, but may also be used directly
+ */
+class CellTileSetCache {
+public:
+    explicit CellTileSetCache(const TilePropertiesInterface & layer):
+        m_layer(&layer)
+    {}
+
+    /** Fills in the tileset and local id of a cell from its gid. */
+    void resolve(TileCell & cell) {
+        if (cell.gid == TilePropertiesInterface::k_no_tile) {
+            cell.tileset = nullptr;
+            cell.tid = 0;
+            return;
+        }
+        if (cell.gid < m_begin_gid || cell.gid >= m_end_gid) {
+            m_tileset = m_layer->tileset_of(cell.gid);
+            // empty cells and unowned gids are not remembered
+            if (m_tileset) {
+                m_begin_gid = m_tileset->begin_gid();
+                m_end_gid   = m_tileset->end_gid();
+            } else {
+                m_begin_gid = m_end_gid = 0;
+                cell.tileset = nullptr;
+                cell.tid = 0;
+                return;
+            }
+        }
+        cell.tileset = m_tileset;
+        cell.tid = cell.gid - m_begin_gid;
+    }
+
+private:
+    const TilePropertiesInterface * m_layer;
+    const TileSetInterface * m_tileset = nullptr;
+    int m_begin_gid = 0;
+    int m_end_gid = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+/** @returns false if nothing of the rectangle is inside the layer, otherwise
+ *           clips the rectangle to the layer
+ */
+inline bool clip_to_layer
+    (const TilePropertiesInterface & layer, int & x, int & y, int & width, int & height)
+{
+    const auto origin = layer.origin();
+    const int right  = std::min(x + width , origin.x + layer.width ());
+    const int bottom = std::min(y + height, origin.y + layer.height());
+    x = std::max(x, origin.x);
+    y = std::max(y, origin.y);
+    width  = right  - x;
+    height = bottom - y;
+    return width > 0 && height > 0;
+}
+
+template <typename Func>
+void for_each_cell
+    (const TilePropertiesInterface & layer, int x, int y, int width, int height,
+     Func && func)
+{
+    if (!clip_to_layer(layer, x, y, width, height)) return;
+    std::vector<int> row_gids(static_cast<std::size_t>(width));
+    CellTileSetCache tilesets(layer);
+    TileCell cell;
+    for (cell.y = y; cell.y != y + height; ++cell.y) {
+        layer.read_gids(x, cell.y, width, row_gids.data());
+        for (int i = 0; i != width; ++i) {
+            cell.x   = x + i;
+            cell.gid = row_gids[std::size_t(i)];
+            tilesets.resolve(cell);
+            func(static_cast<const TileCell &>(cell));
+        }
+    }
+}
+
+template <typename Func>
+void for_each_cell(const TilePropertiesInterface & layer, Func && func) {
+    const auto origin = layer.origin();
+    for_each_cell(layer, origin.x, origin.y, layer.width(), layer.height(),
+                  std::forward<Func>(func));
+}
+
+template <typename Func>
+void for_each_cell_mutable
+    (TilePropertiesInterface & layer, int x, int y, int width, int height,
+     Func && func)
+{
+    if (!clip_to_layer(layer, x, y, width, height)) return;
+    std::vector<int> row_gids(static_cast<std::size_t>(width));
+    CellTileSetCache tilesets(layer);
+    TileCell cell;
+    for (cell.y = y; cell.y != y + height; ++cell.y) {
+        layer.read_gids(x, cell.y, width, row_gids.data());
+        bool row_changed = false;
+        for (int i = 0; i != width; ++i) {
+            int & gid = row_gids[std::size_t(i)];
+            cell.x   = x + i;
+            cell.gid = gid;
+            tilesets.resolve(cell);
+            func(cell);
+            if (cell.gid == gid) continue;
+            gid = cell.gid;
+            row_changed = true;
+        }
+        if (row_changed)
+            layer.write_gids(x, cell.y, width, row_gids.data());
+    }
+}
+
+template <typename Func>
+void for_each_cell_mutable(TilePropertiesInterface & layer, Func && func) {
+    const auto origin = layer.origin();
+    for_each_cell_mutable(layer, origin.x, origin.y, layer.width(), layer.height(),
+                          std::forward<Func>(func));
+}
+
+} // end of tmap namespace
@@ -0,0 +1,97 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <map>
+#include <string>
+
+namespace tmap {
+
+/** How the cells of a (finite) tile layer are laid out in memory. Layers of
+ *  infinite maps are always stored sparsely, by chunk.
+ */
+enum class TileLayerStorage {
+    /** one row after another, favors passes that go row by row (like
+     *  drawing a wide view)
+     */
+    k_row_major,
+
+    /** small square blocks of cells in Z-order, favors neighborhood queries
+     *  (collision around an actor, autotiling) and column-wise passes
+     */
+    k_blocked,
+
+    /** each cell is an index into a small palette of the gids the layer
+     *  uses, packed into as few bits as the palette needs (1, 2, 4, 8 or 16,
+     *  widened as new gids are set), favors memory over speed
+     *  @see TiledMap::compact_tile_layers
+     */
+    k_palette,
+
+    /** each row is kept as runs of the same gid, reads search the row's
+     *  runs (in O(log n)), suits layers which are rarely touched, like
+     *  zone markers or other metadata
+     *  @see MapLoadOptions::promote_hot_layers,
+     *       MapLoadOptions::promote_drawn_layers
+     */
+    k_run_length
+};
+
+/** Options which control how a TiledMap is loaded. The defaults are what
+ *  TiledMap::load_from_file uses when no options are given.
+ */
+struct MapLoadOptions {
+    /** layout used for every finite tile layer */
+    TileLayerStorage tile_layer_storage = TileLayerStorage::k_row_major;
+
+    /** layouts for particular tile layers, by layer name, these take the
+     *  place of tile_layer_storage
+     */
+    std::map<std::string, TileLayerStorage> tile_layer_storage_by_name;
+
+    /** if true, run length layers which are often written to switch to
+     *  row-major storage
+     */
+    bool promote_hot_layers = true;
+
+    /** if true, run length layers which are often read from (drawing reads)
+     *  also switch to row-major storage
+     *  @warning reads (drawing, TilePropertiesInterface::read_gids,
+     *           for_each_cell, the find_tiles_* functions...) then change
+     *           the layer, so a map loaded this way must not be read from
+     *           more than one thread at a time
+     */
+    bool promote_drawn_layers = false;
+
+    /** if true, object geometry (see ObjectGeometry) is made while loading,
+     *  rather than the first time TiledMap::object_geometry is called
+     */
+    bool preprocess_object_geometry = false;
+};
+
+} // end of tmap namespace
@@ -28,6 +28,8 @@
 
 #include <SFML/Graphics/Rect.hpp>
 
+#include <tmap/PropertyKey.hpp>
+
 #include <string>
 #include <map>
 #include <vector>
@@ -65,6 +67,12 @@ struct TileSetInterface {
      */
     virtual int convert_to_local_id(int gid) const = 0;
 
+    /** @returns the first global id owned by this tile set */
+    virtual int begin_gid() const = 0;
+
+    /** @returns one past the last global id owned by this tile set */
+    virtual int end_gid() const = 0;
+
     /** @throws if for some reason that the tile set does not have a texture
      *          (this should only occur if there's a problem with THIS library)
      *  @return const reference to the tileset's texture
@@ -85,13 +93,28 @@ struct TileSetInterface {
 
     /** @param tid local tile set id
      *  @returns property pairs for a given tid
+     *  @note properties are not stored this way, the STL map is made the
+     *        first time it is asked for, find_property is much cheaper
      */
     virtual const PropertyMap * properties_on(int tid) const = 0;
 
+    /** @param tid local tile set id
+     *  @param key interned name of the property
+     *  @returns the value of the tile's property, nullptr if the tile does not
+     *           have that property
+     */
+    virtual const std::string * find_property(int tid, PropertyKey key) const = 0;
+
     /** @param tid local tile set id
      *  @returns the type attribute for the local tile id
      */
     virtual const std::string & type_of(int tid) const = 0;
+
+    /** @param tid local tile set id
+     *  @returns the interned type attribute for the local tile id, an invalid
+     *           key if the tile has no type
+     */
+    virtual PropertyKey type_key_of(int tid) const = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -148,6 +171,20 @@ struct MapObject {
 
 // ----------------------------------------------------------------------------
 
+/** Narrows which map objects a spatial query reports, empty strings match
+ *  any object.
+ *  @see TiledMap::find_objects_in
+ */
+struct MapObjectFilter {
+    /** name of the object group (object layer) objects must come from */
+    std::string group;
+
+    /** value objects' "type" attribute must have */
+    std::string type;
+};
+
+// ----------------------------------------------------------------------------
+
 template <typename T>
 void swap_rectangles(sf::Rect<T> & lhs, sf::Rect<T> & rhs) {
     std::swap(lhs.left  , rhs.left  );
@@ -0,0 +1,256 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/MapObject.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <iterator>
+#include <cstdint>
+
+namespace tmap {
+
+class MapObjectStore;
+
+/** A light handle to one object in a MapObjectStore, offering what a
+ *  MapObject does without owning any of it. @n
+ *  Views stay valid as long as the store they refer to is not changed.
+ */
+class MapObjectView {
+public:
+    using ShapeType    = MapObject::ShapeType;
+    using TileSetPtr   = MapObject::TileSetPtr;
+    using PropertyPair = std::pair<std::string_view, std::string_view>;
+
+    MapObjectView(const MapObjectStore & store_, std::size_t index_):
+        m_store(&store_), m_index(index_)
+    {}
+
+    /** @returns position of this object in the store (and in
+     *           TiledMap::map_objects())
+     */
+    std::size_t index() const { return m_index; }
+
+    /** @copydoc MapObject::name */
+    std::string_view name() const;
+
+    /** @copydoc MapObject::type */
+    std::string_view type() const;
+
+    /** @copydoc MapObject::bounds */
+    const sf::FloatRect & bounds() const;
+
+    /** @copydoc MapObject::shape_type */
+    ShapeType shape_type() const;
+
+    /** @copydoc MapObject::local_tile_id */
+    int local_tile_id() const;
+
+    /** @copydoc MapObject::tile_set */
+    const TileSetPtr & tile_set() const;
+
+    /** @returns number of points defining a polygon or polyline */
+    std::size_t point_count() const;
+
+    /** @returns first of point_count() contiguous points */
+    const sf::Vector2f * points() const;
+
+    /** @returns number of custom properties */
+    std::size_t property_count() const;
+
+    /** @returns name and value of the i-th custom property, properties are
+     *           ordered by name
+     */
+    PropertyPair property(std::size_t i) const;
+
+    /** Looks up a custom property by name (in O(log n)).
+     *  @param value set to the property's value, if found
+     *  @returns true if the object has the property
+     */
+    bool find_property(std::string_view name, std::string_view & value) const;
+
+    /** @returns name of the object group this object was loaded from */
+    std::string_view group() const;
+
+    /** @returns a MapObject with copies of this object's information */
+    MapObject to_map_object() const;
+
+private:
+    const MapObjectStore * m_store;
+    std::size_t m_index;
+};
+
+/** Compact storage for a map's objects. @n
+ *  Fields are kept in parallel arrays (one array per field), while every
+ *  string of every object lives in one shared buffer, and every point in
+ *  another. Loading an object costs no allocations of its own, and passes
+ *  over a single field (like bounds) touch only that field's memory. @n
+ *  @n
+ *  A store is built by adding an object, and then setting the fields of
+ *  that (last added) object. @n
+ *  All arrays are allocated from the memory resource given at construction.
+ */
+class MapObjectStore {
+public:
+    using ShapeType  = MapObject::ShapeType;
+    using TileSetPtr = MapObject::TileSetPtr;
+
+    class ConstIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = MapObjectView;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = MapObjectView;
+
+        ConstIterator(const MapObjectStore & store_, std::size_t index_):
+            m_store(&store_), m_index(index_)
+        {}
+
+        MapObjectView operator * () const { return (*m_store)[m_index]; }
+
+        ConstIterator & operator ++ () { ++m_index; return *this; }
+
+        ConstIterator operator ++ (int) { auto t = *this; ++m_index; return t; }
+
+        bool operator == (const ConstIterator & rhs) const
+            { return m_index == rhs.m_index; }
+
+        bool operator != (const ConstIterator & rhs) const
+            { return m_index != rhs.m_index; }
+
+    private:
+        const MapObjectStore * m_store;
+        std::size_t m_index;
+    };
+
+    MapObjectStore(): MapObjectStore(std::pmr::get_default_resource()) {}
+
+    explicit MapObjectStore(std::pmr::memory_resource *);
+
+    std::size_t size() const { return m_bounds.size(); }
+
+    bool empty() const { return m_bounds.empty(); }
+
+    MapObjectView operator [] (std::size_t i) const { return MapObjectView(*this, i); }
+
+    ConstIterator begin() const { return ConstIterator(*this, 0); }
+
+    ConstIterator end() const { return ConstIterator(*this, size()); }
+
+    // <--------------------------- building --------------------------------->
+
+    /** Adds an object group, objects added after this belong to it. */
+    void add_group(std::string_view name);
+
+    /** Adds an empty object (with an invalid shape), to the last group.
+     *  @returns the new object's index
+     */
+    std::size_t add_object();
+
+    // setters for the last added object
+
+    void set_name(std::string_view);
+
+    void set_type(std::string_view);
+
+    void set_bounds(const sf::FloatRect &);
+
+    void set_shape_type(ShapeType);
+
+    void set_tile(const TileSetPtr &, int local_tile_id);
+
+    /** Adds a custom property, if the object already has a property by that
+     *  name, then the first one is kept.
+     */
+    void add_property(std::string_view name, std::string_view value);
+
+    void add_point(const sf::Vector2f &);
+
+    void reserve_points(std::size_t additional);
+
+    /** Adds every group and object of another store, after those of this
+     *  store, in the same order as they are in the other store.
+     */
+    void append(const MapObjectStore &);
+
+    /** @note both stores must use the same memory resource */
+    void swap(MapObjectStore &);
+
+private:
+    friend class MapObjectView;
+
+    // a string in the shared buffer
+    struct TextRef {
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    struct PropertyRef {
+        TextRef name;
+        TextRef value;
+    };
+
+    // [begin end) into one of the shared arrays
+    struct Range {
+        std::uint32_t begin = 0;
+        std::uint32_t end = 0;
+    };
+
+    static constexpr const std::int32_t k_no_tile_set = -1;
+
+    TextRef add_text(std::string_view);
+
+    std::string_view text_of(const TextRef & ref) const
+        { return std::string_view(m_text.data() + ref.offset, ref.length); }
+
+    std::size_t last() const { return size() - 1; }
+
+    // shared buffers
+    std::pmr::string m_text;
+    std::pmr::vector<PropertyRef> m_properties;
+    std::pmr::vector<sf::Vector2f> m_points;
+    std::pmr::vector<TileSetPtr> m_tile_sets;
+    std::pmr::vector<TextRef> m_group_names;
+
+    // one element per object
+    std::pmr::vector<sf::FloatRect> m_bounds;
+    std::pmr::vector<TextRef> m_names;
+    std::pmr::vector<TextRef> m_types;
+    std::pmr::vector<ShapeType> m_shape_types;
+    std::pmr::vector<int> m_local_tile_ids;
+    std::pmr::vector<std::int32_t> m_tile_set_indices;
+    std::pmr::vector<Range> m_property_ranges;
+    std::pmr::vector<Range> m_point_ranges;
+    std::pmr::vector<std::int32_t> m_groups;
+};
+
+} // end of tmap namespace
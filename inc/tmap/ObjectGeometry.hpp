@@ -0,0 +1,120 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/MapObjectStore.hpp>
+
+#include <SFML/Graphics/Rect.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace tmap {
+
+/** Collision ready geometry for every object of a map, in map pixels (not
+ *  relative to the object). Indices are the same as those of
+ *  TiledMap::map_objects(). @n
+ *  @n
+ *  Per object, the following is kept:
+ *  - a tight bounding box (polygon and polyline points included)
+ *  - triangles covering polygons (by ear clipping) and rectangles
+ *  - edges of polygons, polylines and rectangles
+ *  @n
+ *  Ellipses are kept as their bounding box, and tested exactly. Objects
+ *  without area (points, polylines) never contain a point.
+ */
+class ObjectGeometry {
+public:
+    struct Segment {
+        sf::Vector2f a;
+        sf::Vector2f b;
+    };
+
+    struct Triangle {
+        sf::Vector2f a;
+        sf::Vector2f b;
+        sf::Vector2f c;
+    };
+
+    ObjectGeometry() {}
+
+    /** Preprocesses every object of the store. */
+    explicit ObjectGeometry(const MapObjectStore &);
+
+    /** @returns number of objects */
+    std::size_t size() const { return m_boxes.size(); }
+
+    /** @returns tight bounding box of an object */
+    const sf::FloatRect & bounding_box(std::size_t i) const { return m_boxes[i]; }
+
+    /** @returns number of triangles covering an object */
+    std::size_t triangle_count(std::size_t i) const
+        { return m_triangle_ranges[i].end - m_triangle_ranges[i].begin; }
+
+    /** @returns first of triangle_count(i) contiguous triangles */
+    const Triangle * triangles(std::size_t i) const
+        { return m_triangles.data() + m_triangle_ranges[i].begin; }
+
+    /** @returns number of edges of an object */
+    std::size_t edge_count(std::size_t i) const
+        { return m_edge_ranges[i].end - m_edge_ranges[i].begin; }
+
+    /** @returns first of edge_count(i) contiguous edges */
+    const Segment * edges(std::size_t i) const
+        { return m_edges.data() + m_edge_ranges[i].begin; }
+
+    /** @returns true if the point is inside (or on the edge of) the object's
+     *           shape
+     */
+    bool contains(std::size_t i, sf::Vector2f pt) const;
+
+    /** @returns true if the segment [a b] touches the object's shape, for
+     *           shapes with area this includes segments entirely inside
+     */
+    bool intersects(std::size_t i, sf::Vector2f a, sf::Vector2f b) const;
+
+    void swap(ObjectGeometry &);
+
+private:
+    using ShapeType = MapObject::ShapeType;
+
+    struct Range {
+        std::uint32_t begin = 0;
+        std::uint32_t end = 0;
+    };
+
+    std::vector<sf::FloatRect> m_boxes;
+    std::vector<ShapeType> m_shape_types;
+    std::vector<Range> m_triangle_ranges;
+    std::vector<Range> m_edge_ranges;
+
+    std::vector<Triangle> m_triangles;
+    std::vector<Segment> m_edges;
+};
+
+} // end of tmap namespace
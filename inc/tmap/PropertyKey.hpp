@@ -0,0 +1,76 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+
+namespace tmap {
+
+class PropertyKeyTable;
+
+/** Identifies a property name, or a tile's type name, across a whole map.
+ *  Names are interned when the map is loaded, so client code may look a key
+ *  up by name once (see TiledMap::property_key) and from then on each lookup
+ *  is an integer comparison. @n
+ *  @n
+ *  A key is only meaningful to the map that gave it out (and only until
+ *  that map is loaded again). A default constructed key names nothing, and
+ *  so will never find a property.
+ */
+class PropertyKey {
+public:
+    PropertyKey(): m_id(k_no_key) {}
+
+    bool operator == (const PropertyKey & rhs) const { return m_id == rhs.m_id; }
+
+    bool operator != (const PropertyKey & rhs) const { return m_id != rhs.m_id; }
+
+    /** Keys are ordered by when they were first seen, not by name. */
+    bool operator < (const PropertyKey & rhs) const { return m_id < rhs.m_id; }
+
+    /** @returns true if this key names something */
+    bool is_valid() const { return m_id != k_no_key; }
+
+    std::size_t hash() const { return std::size_t(m_id); }
+
+private:
+    friend class PropertyKeyTable;
+
+    static constexpr const int k_no_key = -1;
+
+    explicit PropertyKey(int id_): m_id(id_) {}
+
+    int m_id;
+};
+
+struct PropertyKeyHasher {
+    std::size_t operator () (const PropertyKey & key) const
+        { return key.hash(); }
+};
+
+} // end of tmap namespace
@@ -0,0 +1,64 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+namespace tmap {
+
+class TileFlagPlanes;
+
+/** Identifies a boolean predicate on tiles, registered with
+ *  TiledMap::register_tile_flag. @n
+ *  Every tile layer keeps one bit per cell for each registered flag, so
+ *  testing a flag never has to look at the tile's properties. @n
+ *  @n
+ *  Flags are only meaningful to the map which gave them out, they stay
+ *  valid when that map is loaded again. A default constructed flag is never
+ *  set for any tile.
+ */
+class TileFlag {
+public:
+    TileFlag(): m_id(k_no_flag) {}
+
+    bool operator == (const TileFlag & rhs) const { return m_id == rhs.m_id; }
+
+    bool operator != (const TileFlag & rhs) const { return m_id != rhs.m_id; }
+
+    /** @returns true if this flag was given out by a map */
+    bool is_valid() const { return m_id != k_no_flag; }
+
+private:
+    friend class TileFlagPlanes;
+
+    static constexpr const int k_no_flag = -1;
+
+    explicit TileFlag(int id_): m_id(id_) {}
+
+    int m_id;
+};
+
+} // end of tmap namespace
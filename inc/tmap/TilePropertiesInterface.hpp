@@ -26,12 +26,19 @@
 
 #pragma once
 
+#include <tmap/PropertyKey.hpp>
+#include <tmap/TileFlag.hpp>
+
 #include <map>
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 namespace tmap {
 
+struct TileSetInterface;
+
 /** Provides an interface to access the properties of any individual tile in
  *  the tile matrix that makes up a TileLayer. In an example, the ground layer
  *  for a TiledMap.
@@ -40,6 +47,14 @@ class TilePropertiesInterface {
 public:
     using PropertyMap = std::map<std::string, std::string>;
 
+    /** Position of a tile in the tile matrix (NOT pixel position) */
+    struct TilePosition {
+        int x = 0;
+        int y = 0;
+    };
+
+    static constexpr const int k_no_tile = 0;
+
     /** Virtual destructor
      *  C++ note: Needed by derivative classes to ensure their destructors are
      *            called when this object is deleted from a base class pointer.
@@ -56,8 +71,74 @@ public:
      */
     virtual const PropertyMap * operator () (int x, int y) const = 0;
 
+    /** Looks up a single property of a tile, without going through (or
+     *  making) an STL map.
+     *  @param key interned property name
+     *  @see TiledMap::property_key
+     *  @return Returns the property's value, or nullptr if there is no tile
+     *          here or the tile does not have that property.
+     */
+    virtual const std::string * find_property(int x, int y, PropertyKey key) const = 0;
+
+    /** @return Returns the interned type name of the tile, an invalid key if
+     *          there is no tile here or the tile has no type
+     */
+    virtual PropertyKey tile_type(int x, int y) const = 0;
+
+    /** @param flag registered with TiledMap::register_tile_flag
+     *  @return Returns true if the tile here satisfies the flag
+     */
+    virtual bool test_flag(TileFlag flag, int x, int y) const = 0;
+
+    /** Reads a flag for a run of tiles in a row at once.
+     *  @param length number of tiles, at most 64
+     *  @return Returns a word where bit i is the flag of the tile at
+     *          (x + i, y), tiles outside of the layer are never flagged
+     */
+    virtual std::uint64_t flag_span(TileFlag flag, int x, int y, int length) const = 0;
+
+    /** @return Returns true if any tile in the rectangle satisfies the flag */
+    virtual bool any_flag_in
+        (TileFlag flag, int x, int y, int width, int height) const = 0;
+
+    /** @return Returns the number of tiles in the rectangle which satisfy the
+     *          flag
+     */
+    virtual int count_flag_in
+        (TileFlag flag, int x, int y, int width, int height) const = 0;
+
+    /** Starts keeping an index from each gid to the positions of the tiles
+     *  which have it, so that the find_tiles_* functions cost time in
+     *  proportion to what they find, rather than to the size of the layer.
+     *  The index is kept up to date by set_tile_gid. @n
+     *  It costs eight bytes per (non-empty) tile, and must be enabled again
+     *  after the map is loaded again.
+     */
+    virtual void enable_position_index() = 0;
+
+    /** Appends the positions of all tiles with the given gid, in row-major
+     *  order (by y, then x).
+     *  @note without a position index this scans the whole layer
+     */
+    virtual void find_tiles_with_gid
+        (int gid, std::vector<TilePosition> & out) const = 0;
+
+    /** Appends the positions of all tiles which have the given property, in
+     *  row-major order.
+     *  @copydetails find_tiles_with_gid
+     */
+    virtual void find_tiles_with_property
+        (PropertyKey key, std::vector<TilePosition> & out) const = 0;
+
+    /** Appends the positions of all tiles of the given type, in row-major
+     *  order.
+     *  @copydetails find_tiles_with_gid
+     */
+    virtual void find_tiles_of_type
+        (PropertyKey type, std::vector<TilePosition> & out) const = 0;
+
     /** Sets gid of a specific tile, good for changing the map at runtime.
-     *  @param new_gid new global tile id
+     *  @param new_gid new global tile id, zero removes the tile
      *  @throw Will throw a std::runtime_error if the new_gid is not associated
      *         with any tileset in the loaded map.
      */
@@ -66,7 +147,71 @@ public:
     /** @return Returns global id of the tile */
     virtual int tile_gid(int x, int y) const = 0;
 
-    /** @return Returns the width of the tile matrix in tiles */
+    /** Copies a run of gids in a row, one virtual call for the whole run.
+     *  @param length number of gids to copy
+     *  @param out    buffer with room for length gids, tiles outside of the
+     *                layer read as k_no_tile
+     *  @see for_each_cell
+     */
+    virtual void read_gids(int x, int y, int length, int * out) const = 0;
+
+    /** Sets a run of gids in a row, as set_tile_gid would one at a time.
+     *  @param length number of gids to write, the run must lie inside of the
+     *                layer (for finite maps)
+     *  @throw Will throw a std::out_of_range if the run does not lie inside
+     *         of a finite layer, or a std::runtime_error if any gid is not
+     *         associated with a tileset, in which case no tile is changed.
+     */
+    virtual void write_gids(int x, int y, int length, const int * gids) = 0;
+
+    /** Copies a rectangle of gids, in row-major order.
+     *  @param out buffer with room for width*height gids, tiles outside of
+     *             the layer read as k_no_tile
+     */
+    virtual void read_region(int x, int y, int width, int height, int * out) const = 0;
+
+    /** Sets a rectangle of gids from a buffer in row-major order. Each
+     *  distinct gid is checked once, and flag planes and the position index
+     *  are brought up to date once for the whole rectangle.
+     *  @param gids width*height gids, the rectangle must lie inside of the
+     *              layer (for finite maps)
+     *  @throw Will throw a std::out_of_range if the rectangle does not lie
+     *         inside of a finite layer, or a std::runtime_error if any gid is
+     *         not associated with a tileset, in which case no tile is
+     *         changed.
+     */
+    virtual void write_region
+        (int x, int y, int width, int height, const int * gids) = 0;
+
+    /** Sets every tile of a rectangle to the same gid.
+     *  @copydetails write_region
+     */
+    virtual void fill_region(int x, int y, int width, int height, int gid) = 0;
+
+    /** Replaces the gid of the tile at (x, y), and of every tile connected
+     *  to it (through its four neighbors) with the same gid.
+     *  @note the region does not extend outside of the area given by
+     *        origin(), width() and height()
+     *  @throw Will throw a std::runtime_error if new_gid is not associated
+     *         with a tileset, in which case no tile is changed.
+     *  @return Returns the number of tiles changed
+     */
+    virtual int flood_replace(int x, int y, int new_gid) = 0;
+
+    /** @return Returns the tileset which owns the gid, nullptr for
+     *          k_no_tile and gids no tileset owns
+     */
+    virtual const TileSetInterface * tileset_of(int gid) const = 0;
+
+    /** @return Returns the position of the top-left tile of the area given
+     *          by width() and height(), always (0, 0) for finite maps
+     */
+    virtual TilePosition origin() const = 0;
+
+    /** @return Returns the width of the tile matrix in tiles
+     *  @note for infinite maps this is the width of the area containing
+     *        tiles, which need not start at zero
+     */
     virtual int width() const = 0;
 
     /** @return Returns the height of the tile matrix in tiles */
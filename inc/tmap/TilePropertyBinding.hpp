@@ -0,0 +1,182 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+namespace tmap {
+
+class TiledMap;
+class TiledMapImpl;
+
+/** Functions used by TilePropertyBinding to turn property values into
+ *  fields, each return false if the value cannot be read as that type.
+ *  Booleans accept "true", "false", "1" and "0" (which is what Tiled
+ *  writes).
+ */
+bool parse_tile_property(const std::string &, bool &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, int &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, unsigned &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, long &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, float &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, double &);
+
+/** @copydoc parse_tile_property(const std::string&,bool&) */
+bool parse_tile_property(const std::string &, std::string &);
+
+/** Describes how a client struct is filled in from a tile's properties, each
+ *  field is bound to one property name. @n
+ *  Fields of tiles without the bound property keep the value they have in
+ *  the default struct.
+ *  @tparam T client struct, must be copyable
+ *  @see TiledMap::bind_tile_properties
+ */
+template <typename T>
+class TilePropertyBinding {
+public:
+    using AssignFunc = std::function<void(const std::string &, T &)>;
+
+    struct Field {
+        std::string property_name;
+        AssignFunc assign;
+    };
+
+    explicit TilePropertyBinding(const T & default_value_ = T()):
+        m_default(default_value_)
+    {}
+
+    /** Binds a field to a property, the value is converted with
+     *  parse_tile_property.
+     *  @throws (later, when the table is built) std::runtime_error if a
+     *          tile's value cannot be read as the field's type
+     */
+    template <typename FieldType>
+    TilePropertyBinding & bind(const char * property_name, FieldType T::* field);
+
+    /** Binds a property to a client function, which does the conversion.
+     *  @param f callable with signature: @n
+     *           void f(const std::string & value, T & obj)
+     */
+    template <typename Func>
+    TilePropertyBinding & bind_with(const char * property_name, Func && f);
+
+    const T & default_value() const { return m_default; }
+
+    const std::vector<Field> & fields() const { return m_fields; }
+
+private:
+    T m_default;
+    std::vector<Field> m_fields;
+};
+
+/** Type erased part of a TilePropertyTable, which lets TiledMap rebuild
+ *  every table whenever its tilesets change.
+ */
+class TilePropertyTableBase {
+public:
+    virtual ~TilePropertyTableBase();
+
+private:
+    friend class TiledMap;
+
+    virtual void rebuild(const TiledMap &) = 0;
+};
+
+/** A dense array of client structs, indexed by gid, made from tile
+ *  properties by way of a TilePropertyBinding. Looking up a tile's struct
+ *  is a single array access. @n
+ *  Gids not owned by any tileset (including zero, "no tile") map to the
+ *  binding's default struct.
+ */
+template <typename T>
+class TilePropertyTable final : public TilePropertyTableBase {
+public:
+    explicit TilePropertyTable(TilePropertyBinding<T> && binding):
+        m_binding(std::move(binding))
+    {}
+
+    /** @returns struct for the given gid, the default struct if the gid is
+     *           not owned by any tileset
+     */
+    const T & operator [] (int gid) const {
+        if (gid < 0 || gid >= int(m_values.size())) return m_binding.default_value();
+        return m_values[std::size_t(gid)];
+    }
+
+    /** @returns every struct, indexed by gid */
+    const std::vector<T> & values() const { return m_values; }
+
+private:
+    void rebuild(const TiledMap &) override;
+
+    TilePropertyBinding<T> m_binding;
+    std::vector<T> m_values;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+template <typename FieldType>
+TilePropertyBinding<T> & TilePropertyBinding<T>::bind
+    (const char * property_name, FieldType T::* field)
+{
+    std::string name = property_name;
+    m_fields.push_back(Field { name, [name, field]
+        (const std::string & value, T & obj)
+    {
+        if (parse_tile_property(value, obj.*field)) return;
+        throw std::runtime_error("TilePropertyBinding: cannot read value \""
+                                 + value + "\" of tile property \"" + name
+                                 + "\" as the type of the field it is bound to.");
+    }});
+    return *this;
+}
+
+template <typename T>
+template <typename Func>
+TilePropertyBinding<T> & TilePropertyBinding<T>::bind_with
+    (const char * property_name, Func && f)
+{
+    m_fields.push_back(Field { property_name, AssignFunc(std::forward<Func>(f)) });
+    return *this;
+}
+
+} // end of tmap namespace
@@ -29,11 +29,19 @@
 #include <map>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <functional>
+#include <algorithm>
+#include <memory_resource>
 
 #include <tmap/MapObject.hpp>
+#include <tmap/MapObjectStore.hpp>
+#include <tmap/MapLoadOptions.hpp>
+#include <tmap/ObjectGeometry.hpp>
 #include <tmap/TileEffect.hpp>
 #include <tmap/TilePropertiesInterface.hpp>
+#include <tmap/TilePropertyBinding.hpp>
+#include <tmap/CellVisitor.hpp>
 
 // forwards for SFML
 namespace sf {
@@ -62,10 +70,24 @@ class TiledMapImpl;
  *  - provide an STL interface into tile information, map properties and
  *    objects (loaded from object layers)
  *  - Objects from object layers are all loaded into a map objects container
- *    accessible from the TiledMap interface
- *  - supports tile encoding for base64 and base64 + Zlib + CSV + plain XML
+ *    accessible from the TiledMap interface, with a spatial index for area,
+ *    point and radius queries, and preprocessed geometry for exact
+ *    point and segment tests
+ *  - supports tile encoding for base64 and base64 + Zlib/gzip + CSV + plain
+ *    XML, and base64 + Zstandard if built with MACRO_USE_ZSTD (as are whole
+ *    compressed map files)
+ *  - supports "infinite" maps, whose layers only use memory for the chunks
+ *    that have tiles in them
  *  - layers can be iterated using thier names as bounds, layers may only be
  *    drawn, not modified
+ *  - boolean tile flags, stored as a bit plane per tile layer, may be
+ *    registered for fast collision and trigger checks
+ *  - whole layers (or rectangles of them) may be visited cell by cell with
+ *    for_each_cell, without a virtual call per tile
+ *  - tiles may be read, written, filled and flood replaced a rectangle (or
+ *    region) at a time
+ *  - tile properties may be bound to client structs, which are kept in a
+ *    dense array indexed by gid
  *  - tile effects, any tile in a tileset (not individual tiles in a map)
  *    can have additional work done on the sprites and rendered multiple times
  *    allowing for graphical effects
@@ -99,6 +121,23 @@ public:
     using TileSetPtr         = MapObject::TileSetPtr;
 
     TiledMap();
+
+    /** @param resource where tile layers' cells (and palettes, runs or
+     *                  chunks, by layout) and map objects (their arrays
+     *                  and text) are allocated from, must outlive the map.
+     *                  These are the bulk of a large map, so a monotonic
+     *                  resource releases most of it at once.
+     *  @note Not everything comes from the resource: layer and tile matrix
+     *        objects themselves, tilesets and their textures, property
+     *        maps, flag planes and indexes still use the global heap, and
+     *        are freed one by one as before.
+     *  @note Unless resource is std::pmr::new_delete_resource() (which the
+     *        default resource normally is), maps are loaded on a single
+     *        thread, as resources (monotonic ones included) are not safe
+     *        to share between threads.
+     */
+    explicit TiledMap(std::pmr::memory_resource * resource);
+
     TiledMap(const TiledMap &) = delete;
     TiledMap(TiledMap &&);
     ~TiledMap();
@@ -119,6 +158,12 @@ public:
     //! @copydoc TiledMap::load_from_file(const char*)
     void load_from_file(const std::string &);
 
+    /** @copydoc TiledMap::load_from_file(const char*)
+     *  @param options controls how the map's contents are stored
+     *  @see MapLoadOptions
+     */
+    void load_from_file(const char * filename, const MapLoadOptions & options);
+
     /** Sets the amount which tile rendering will be offset.
      *  @param offset offset vector to displace rendering
      */
@@ -154,6 +199,33 @@ public:
      */
     TileSetPtr get_tile_set_for_gid(int gid) const noexcept;
 
+    /** @returns one past the greatest gid owned by any of the map's tile
+     *           sets, one if the map has no tile sets
+     */
+    int end_gid() const noexcept;
+
+    /** Builds a dense table of client structs, one for each gid, filling
+     *  fields from tile properties as described by the binding. The table is
+     *  rebuilt each time a map is loaded, so it may be made before the first
+     *  load.
+     *
+     *  Example: @n
+     *  struct TileInfo { float friction = 1.f; bool solid = false; }; @n
+     *  const auto & infos = map.bind_tile_properties(
+     *      TilePropertyBinding<TileInfo>()
+     *      .bind("friction", &TileInfo::friction)
+     *      .bind("solid"   , &TileInfo::solid   )); @n
+     *  float f = infos[layer.tile_gid(x, y)].friction;
+     *
+     *  @throws std::runtime_error if a bound property's value cannot be
+     *          converted, this is also thrown by load_from_file (basic
+     *          guarantee, the map is loaded but tables may be out of date)
+     *  @return Returns a reference to the table, which lives as long as this
+     *          map's contents (and moves with them on swap).
+     */
+    template <typename T>
+    const TilePropertyTable<T> & bind_tile_properties(TilePropertyBinding<T> binding);
+
     /** Finds a tile layer by name, if the name's are amibigiuous, then only
      *  the first layer with that name is returned.
      *  @param  name Name of the layer to find.
@@ -171,15 +243,119 @@ public:
      */
     TilePropertiesInterface * find_tile_layer(const std::string & name);
 
+    /** Finds the interned key for a tile property name (or tile type name),
+     *  the key may then be used for cheap property lookups.
+     *  @param name property or type name (case sensitive)
+     *  @return Returns an invalid key if no tile in the map uses that name.
+     *  @see TilePropertiesInterface::find_property
+     */
+    PropertyKey property_key(const std::string & name) const;
+
+    /** Registers a boolean flag, set for tiles which have the given property.
+     *  Every tile layer keeps a bit plane for each flag, so flags may be
+     *  tested per tile, a row at a time or over whole rectangles cheaply.
+     *  Planes are built at load and kept up to date by set_tile_gid. @n
+     *  Flags stay registered when another map is loaded.
+     *  @param property_name name of the property (case sensitive)
+     *  @return Returns a handle for use with TilePropertiesInterface's flag
+     *          queries.
+     *  @see TilePropertiesInterface::test_flag
+     */
+    TileFlag register_tile_flag(const std::string & property_name);
+
+    /** Registers a boolean flag, set for tiles whose property equals the given
+     *  value.
+     *  @copydetails TiledMap::register_tile_flag(const std::string&)
+     */
+    TileFlag register_tile_flag
+        (const std::string & property_name, const std::string & value);
+
+    /** Registers a boolean flag, set for tiles whose gid is one of the given
+     *  gids. Gids are taken as they are, for every map loaded.
+     *  @copydetails TiledMap::register_tile_flag(const std::string&)
+     */
+    TileFlag register_tile_flag(const std::vector<int> & gids);
+
+    /** Has every tile layer keep a summed-area table for the given flag, so
+     *  that TilePropertiesInterface::count_flag_in and any_flag_in take
+     *  O(log n) time (n being the layer's number of 16x16 chunks), no matter
+     *  the size of the rectangle. @n
+     *  Tables are kept up to date by set_tile_gid, each change rewrites part
+     *  of the 16x16 chunk it is in, and O(log n) entries of the tables over
+     *  whole chunks. @n
+     *  Tables cost roughly two bytes per tile, and stay enabled when
+     *  another map is loaded.
+     *  @throws std::runtime_error if the flag was not registered with this
+     *          map
+     */
+    void enable_flag_counts(TileFlag flag);
+
+    /** Releases memory tile layers no longer need, for layers stored with
+     *  TileLayerStorage::k_palette this drops gids no longer in use and
+     *  narrows each cell if it can. Other layouts have nothing to release.
+     *  @see MapLoadOptions
+     */
+    void compact_tile_layers();
+
     /** @return Returns map-wide properties as an STL map of string -> string.
      */
     const PropertyMap & map_properties() const;
 
     /** @return Returns a container (constant reference) with all objects that
      *          were found in object layers.
+     *  @note The container is made from map_object_store() the first time
+     *        it is asked for (after each load). It is a full copy of every
+     *        object, strings and points included, so it roughly doubles the
+     *        memory objects take; map_object_store() is the cheaper way to
+     *        go through objects. Making it is safe while other threads read
+     *        the map.
      */
     const MapObjectContainer & map_objects() const;
 
+    /** @return Returns all objects found in object layers, in the same order
+     *          as map_objects(), stored compactly and read through
+     *          MapObjectView.
+     */
+    const MapObjectStore & map_object_store() const;
+
+    /** Finds objects whose bounding box overlaps an area, by way of a
+     *  spatial index built when the map is loaded.
+     *  @param area   area in pixels
+     *  @param out    indices into map_objects() are appended here, in
+     *                ascending order
+     *  @param filter only objects matching the filter are reported
+     */
+    void find_objects_in(const sf::FloatRect & area, std::vector<std::size_t> & out,
+                         const MapObjectFilter & filter = MapObjectFilter()) const;
+
+    /** Finds objects whose bounding box contains a point.
+     *  @copydetails TiledMap::find_objects_in
+     */
+    void find_objects_at(const sf::Vector2f & point, std::vector<std::size_t> & out,
+                         const MapObjectFilter & filter = MapObjectFilter()) const;
+
+    /** Finds objects whose bounding box comes within radius of a point.
+     *  @copydetails TiledMap::find_objects_in
+     */
+    void find_objects_near
+        (const sf::Vector2f & center, float radius, std::vector<std::size_t> & out,
+         const MapObjectFilter & filter = MapObjectFilter()) const;
+
+    /** @param object_index index into map_objects()
+     *  @return Returns the name of the object group the object was loaded
+     *          from.
+     */
+    std::string_view object_group_of(std::size_t object_index) const;
+
+    /** @return Returns collision ready geometry (triangles, edges, tight
+     *          bounding boxes) for every object, indexed like map_objects().
+     *  @note Made the first time it is asked for (after each load), unless
+     *        MapLoadOptions::preprocess_object_geometry was set. Making it
+     *        is safe while other threads read the map, though the first
+     *        caller waits for it to be made.
+     */
+    const ObjectGeometry & object_geometry() const;
+
     /** @brief Forward iterator, refering to the first map layer.
      *
      *  TiledMap offers an interface to iterate the map layers without exposing
@@ -250,6 +426,11 @@ public:
 private:
     using IterValuePair = TileEffectAssignmentPriv::IterValuePair;
 
+    // takes ownership, builds the table for the current map
+    void add_tile_property_table(TilePropertyTableBase *);
+
+    void rebuild_tile_property_tables();
+
     // need a way to differenciate between beginning and ending iterator
     IterValuePair find_tile_effect_ref_and_name
         (const char * name, const IterValuePair & prev);
@@ -270,6 +451,42 @@ void TiledMap::access_tile_effect(const char * attribute, Func && val_teffect_f)
     }
 }
 
+template <typename T>
+const TilePropertyTable<T> & TiledMap::bind_tile_properties
+    (TilePropertyBinding<T> binding)
+{
+    auto * table = new TilePropertyTable<T>(std::move(binding));
+    add_tile_property_table(table);
+    return *table;
+}
+
+template <typename T>
+void TilePropertyTable<T>::rebuild(const TiledMap & map) {
+    std::vector<PropertyKey> keys;
+    keys.reserve(m_binding.fields().size());
+    for (const auto & field : m_binding.fields()) {
+        keys.push_back(map.property_key(field.property_name));
+    }
+
+    std::vector<T> values(std::size_t(map.end_gid()), m_binding.default_value());
+    for (int gid = 1; gid < map.end_gid(); ) {
+        auto tset = map.get_tile_set_for_gid(gid);
+        if (!tset) break;
+        // gids between tile sets are skipped, they keep the default
+        gid = std::max(gid, tset->begin_gid());
+        for (; gid != tset->end_gid(); ++gid) {
+            int tid = gid - tset->begin_gid();
+            for (std::size_t i = 0; i != keys.size(); ++i) {
+                if (!keys[i].is_valid()) continue;
+                const auto * value = tset->find_property(tid, keys[i]);
+                if (!value) continue;
+                m_binding.fields()[i].assign(*value, values[std::size_t(gid)]);
+            }
+        }
+    }
+    m_values.swap(values);
+}
+
 inline void TiledMap::load_from_file(const std::string & filename) {
     load_from_file(filename.c_str());
 }
@@ -27,16 +27,106 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <functional>
+
+struct z_stream_s;
 
 namespace ZLib {
 
 using UInt8      = unsigned char;
 using ByteBuffer = std::vector<UInt8>;
 
+/** Inflates ZLib or gzip compressed data, which it is is told by its
+ *  header.
+ */
 ByteBuffer decompress(const ByteBuffer & src_data);
 
 ByteBuffer decompress(const ByteBuffer & src_data, ByteBuffer & cache_data);
 
+/** Inflates compressed data held anywhere in memory (like a mapped file).
+ *  @param cache_data memory the result may take over, instead of allocating
+ */
+ByteBuffer decompress
+    (const UInt8 * src_data, std::size_t src_size, ByteBuffer & cache_data);
+
+/** Inflates ZLib or gzip compressed data straight into caller provided
+ *  memory, for when the size of the inflated data is known beforehand (like
+ *  a tile layer's).
+ *  @throws if the data does not fit the output, or if the data is not valid
+ *          or ends before its stream does
+ *  @return number of bytes written to out
+ */
+std::size_t decompress
+    (const UInt8 * src, std::size_t src_size,
+     UInt8 * out, std::size_t out_capacity);
+
+/** Inflates one ZLib (or gzip) stream a piece at a time. Input may be given in pieces
+ *  of any size, and output goes wherever the caller points it, so neither the
+ *  whole compressed nor the whole inflated data need ever be held.
+ */
+class Inflater {
+public:
+    /** A run of inflated bytes, owned by the inflater. */
+    struct OutputChunk {
+        const UInt8 * data = nullptr;
+        std::size_t size = 0;
+    };
+
+    static constexpr const std::size_t k_default_chunk_size = 16384;
+
+    /** @param chunk_size size of the chunks given by inflate_chunk */
+    explicit Inflater(std::size_t chunk_size = k_default_chunk_size);
+
+    Inflater(const Inflater &) = delete;
+
+    Inflater & operator = (const Inflater &) = delete;
+
+    ~Inflater();
+
+    /** Sets where inflated bytes are written next, replacing any previously
+     *  set output. The output may be larger than ZLib itself can count.
+     */
+    void set_output(UInt8 * out, std::size_t out_size);
+
+    /** Inflates as much of the input as possible, stopping early if the
+     *  output fills or the stream ends.
+     *  @throws if the stream is not valid ZLib data
+     *  @return number of input bytes consumed
+     */
+    std::size_t inflate(const UInt8 * in, std::size_t in_size);
+
+    /** Inflates input into the inflater's own chunk buffer, for callers that
+     *  would rather take output as it comes than say where it goes. Call
+     *  again with the same (advanced) input for the next chunk.
+     *
+     *  This replaces any output set by set_output.
+     *  @param in moved past the input consumed
+     *  @throws if the stream is not valid ZLib data
+     *  @return the inflated bytes, which remain valid until the next call;
+     *          this is empty only when more input is needed or the stream
+     *          has finished
+     */
+    OutputChunk inflate_chunk(const UInt8 *& in, const UInt8 * in_end);
+
+    /** @return number of bytes which may still be written to the output */
+    std::size_t output_remaining() const;
+
+    /** @return true once the end of the stream has been inflated */
+    bool finished() const { return m_finished; }
+
+private:
+    // ZLib's avail_out is (usually) 32-bit, output past what it can hold
+    // is counted here, and handed to ZLib as avail_out runs out
+    void top_up_output();
+
+    std::unique_ptr<z_stream_s> m_strm;
+    std::size_t m_output_beyond = 0;
+    bool m_finished = false;
+    std::size_t m_chunk_size;
+    ByteBuffer m_chunk;
+};
+
 enum class CompressionLevel {
     k_default_compression = -1,
     k_no_compression      =  0,
@@ -45,6 +135,36 @@ enum class CompressionLevel {
     k_best_compression    =  9
 };
 
+/** Takes compressed bytes, in order, as they are made. */
+using OutputSink = std::function<void(const UInt8 *, std::size_t)>;
+
+/** Options which control how compress splits its work between threads. */
+struct CompressOptions {
+    /** input bytes deflated as one piece by one thread; smaller blocks
+     *  spread better over threads, but compress (slightly) worse
+     */
+    std::size_t block_size = 128*1024;
+
+    /** most threads used, zero for as many as the hardware offers */
+    std::size_t max_threads = 0;
+
+    /** about the most memory held by compressed blocks waiting on the sink,
+     *  blocks are compressed in batches which fit in this
+     */
+    std::size_t memory_budget = 16*1024*1024;
+};
+
+/** Deflates data into a single ZLib stream, in the way pigz does: the input
+ *  is split into blocks, which are deflated in parallel (each primed with
+ *  the 32K of input before it), then joined.
+ *  @param sink given each piece of the stream in order
+ *  @throws if the ZLib state cannot be made, or whatever the sink throws
+ */
+void compress
+    (const UInt8 * src, std::size_t src_size, CompressionLevel level,
+     const OutputSink & sink,
+     const CompressOptions & options = CompressOptions());
+
 ByteBuffer compress(const ByteBuffer & src, CompressionLevel level);
 
 ByteBuffer compress
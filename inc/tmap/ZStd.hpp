@@ -0,0 +1,100 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+struct ZSTD_DCtx_s;
+
+/** Zstandard decompression, offered the same way as ZLib's. @n
+ *  Zstandard support is optional, tmap must be built with MACRO_USE_ZSTD
+ *  defined (and linked against libzstd) for it. Without it every function
+ *  here throws.
+ */
+namespace ZStd {
+
+using UInt8      = unsigned char;
+using ByteBuffer = std::vector<UInt8>;
+
+/** @returns true if tmap was built with Zstandard support */
+bool is_supported();
+
+/** @returns true if the data starts as a Zstandard frame does */
+bool has_magic_number(const UInt8 * data, std::size_t size);
+
+ByteBuffer decompress(const ByteBuffer & src_data);
+
+ByteBuffer decompress(const ByteBuffer & src_data, ByteBuffer & cache_data);
+
+/** @copydoc ZLib::decompress(const UInt8*,std::size_t,ByteBuffer&) */
+ByteBuffer decompress
+    (const UInt8 * src_data, std::size_t src_size, ByteBuffer & cache_data);
+
+/** Decompresses one Zstandard frame a piece at a time, works the same as
+ *  ZLib::Inflater.
+ */
+class Decompressor {
+public:
+    Decompressor();
+
+    Decompressor(const Decompressor &) = delete;
+
+    Decompressor & operator = (const Decompressor &) = delete;
+
+    ~Decompressor();
+
+    /** @copydoc ZLib::Inflater::set_output */
+    void set_output(UInt8 * out, std::size_t out_size);
+
+    /** Decompresses as much of the input as possible, stopping early if the
+     *  output fills or the frame ends.
+     *  @throws if the frame is not valid Zstandard data
+     *  @return number of input bytes consumed
+     */
+    std::size_t decompress(const UInt8 * in, std::size_t in_size);
+
+    /** @copydoc ZLib::Inflater::output_remaining */
+    std::size_t output_remaining() const { return m_out_size - m_out_pos; }
+
+    /** @return true once the end of the frame has been decompressed */
+    bool finished() const { return m_finished; }
+
+private:
+    struct ContextDeleter {
+        void operator () (ZSTD_DCtx_s *) const;
+    };
+
+    std::unique_ptr<ZSTD_DCtx_s, ContextDeleter> m_context;
+    UInt8 * m_out = nullptr;
+    std::size_t m_out_size = 0;
+    std::size_t m_out_pos = 0;
+    bool m_finished = false;
+};
+
+} // end of ZStd namespace
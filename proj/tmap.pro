@@ -36,37 +36,70 @@ debug {
     #INSTALLS += target
 #}
 
-QMAKE_CXXFLAGS += -std=c++17
-QMAKE_LFLAGS   += -std=c++17
+QMAKE_CXXFLAGS += -std=c++17 -pthread
+QMAKE_LFLAGS   += -std=c++17 -pthread
 LIBS           += -ltinyxml2 -lsfml-graphics -lsfml-window -lsfml-system -lz
 
+# Zstandard compressed maps and layers are optional: CONFIG+=zstd
+zstd {
+    DEFINES += MACRO_USE_ZSTD
+    LIBS    += -lzstd
+}
+
 SOURCES += \
     ../src/Base64.cpp        \
     ../src/ColorLayer.cpp    \
+    ../src/MapObjectIndex.cpp \
+    ../src/MappedFile.cpp    \
+    ../src/MapObjectStore.cpp \
+    ../src/ObjectGeometry.cpp \
+    ../src/PropertyKeyTable.cpp \
+    ../src/TileCountTable.cpp \
     ../src/TiledMap.cpp      \
     ../src/TiledMapImpl.cpp  \
     ../src/TileEffect.cpp    \
+    ../src/TileFlagPlanes.cpp \
     ../src/TileLayer.cpp     \
+    ../src/TileMatrix.cpp    \
+    ../src/TilePositionIndex.cpp \
+    ../src/TilePropertyBinding.cpp \
     ../src/TileSet.cpp       \
     ../src/TiXmlHelpers.cpp  \
-    ../src/ZLib.cpp
+    ../src/ZLib.cpp          \
+    ../src/ZStd.cpp
 
 HEADERS += \
     ../src/ColorLayer.hpp    \
     ../src/MapLayer.hpp      \
+    ../src/MapObjectIndex.hpp \
+    ../src/MappedFile.hpp    \
+    ../src/Parallel.hpp      \
+    ../src/PropertyKeyTable.hpp \
+    ../src/TileCountTable.hpp \
     ../src/TiledMapImpl.hpp  \
+    ../src/TileFlagPlanes.hpp \
     ../src/TileLayer.hpp     \
+    ../src/TileMatrix.hpp    \
+    ../src/TilePositionIndex.hpp \
     ../src/TileSet.hpp       \
     ../src/TiXmlHelpers.hpp
 
 
 HEADERS += \
     ../inc/tmap/Base64.hpp                  \
+    ../inc/tmap/CellVisitor.hpp             \
+    ../inc/tmap/MapLoadOptions.hpp          \
     ../inc/tmap/MapObject.hpp               \
+    ../inc/tmap/MapObjectStore.hpp          \
+    ../inc/tmap/ObjectGeometry.hpp          \
+    ../inc/tmap/PropertyKey.hpp             \
+    ../inc/tmap/TileFlag.hpp                \
     ../inc/tmap/TilePropertiesInterface.hpp \
+    ../inc/tmap/TilePropertyBinding.hpp     \
     ../inc/tmap/TileEffect.hpp              \
     ../inc/tmap/TiledMap.hpp                \
-    ../inc/tmap/ZLib.hpp
+    ../inc/tmap/ZLib.hpp                    \
+    ../inc/tmap/ZStd.hpp
 
 SOURCES += \
     ../demo/map-demo.cpp
@@ -30,6 +30,11 @@
 
 #include <cassert>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#   define MACRO_BASE64_X86_SIMD
+#   include <immintrin.h>
+#endif
+
 using Error = std::runtime_error;
 
 namespace Base64 {
@@ -40,9 +45,22 @@ namespace /* anonymous */ {
 const char * const k_encode_table = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                     "abcdefghijklmnopqrstuvwxyz0123456789+/";
 
-void encode_chunk
-    (const ByteBuffer & data, std::string & str,
-     std::size_t chunk_index, std::size_t chunk_size);
+// Block encoders encode whole three byte chunks, as many as there are.
+// @return number of bytes encoded, which is always a multiple of three
+using BlockEncoder = std::size_t(*)(const UInt8 * beg, const UInt8 * end, char * out);
+
+/** Encodes using the fastest block encoder the CPU supports, which is chosen
+ *  the first time this is called.
+ */
+std::size_t encode_blocks(const UInt8 * beg, const UInt8 * end, char * out);
+
+std::size_t encode_blocks_scalar(const UInt8 * beg, const UInt8 * end, char * out);
+
+#ifdef MACRO_BASE64_X86_SIMD
+std::size_t encode_blocks_ssse3(const UInt8 * beg, const UInt8 * end, char * out);
+
+std::size_t encode_blocks_avx2(const UInt8 * beg, const UInt8 * end, char * out);
+#endif
 
 } // end of <anonymous> namespace
 
@@ -52,30 +70,28 @@ std::string encode(const ByteBuffer & data) {
 }
 
 std::string encode(const ByteBuffer & data, std::string & cache_str) {
-    std::string str;
-    str.reserve((data.size()*4)/3);
-
     // let's say you don't want that extra nasty allocation :)
-    cache_str.swap(str);
-    str.clear();
-
-    // encoding table
-    std::size_t chunk_count = data.size() / 3;
-    std::size_t rem_bytes   = data.size() % 3;
+    std::string str;
+    str.swap(cache_str);
+    str.resize(((data.size() + 2) / 3)*4);
+    if (data.empty()) return str;
 
     // encode complete chunks
-    // doing it this way prevents both code duplication and also allows g++ to
-    // make use of one of it's common optimizations, emiting code specific to
-    // a constant value
-    for (std::size_t i = 0; i != chunk_count*3; i += 3)
-        encode_chunk(data, str, i, 3);
-
-    if (rem_bytes == 2) {
-        encode_chunk(data, str, chunk_count, 2);
-        str += "=";
-    } else if (rem_bytes == 1) {
-        encode_chunk(data, str, chunk_count, 1);
-        str += "==";
+    const std::size_t encoded =
+        encode_blocks(data.data(), data.data() + data.size(), &str[0]);
+
+    // the last one or two bytes, with padding
+    const std::size_t rem_bytes = data.size() - encoded;
+    if (rem_bytes != 0) {
+        // first is most significant, last -> least
+        unsigned bits = unsigned(data[encoded]) << 16;
+        if (rem_bytes == 2)
+            bits |= unsigned(data[encoded + 1]) << 8;
+        char * out = &str[(encoded / 3)*4];
+        out[0] = k_encode_table[(bits >> 18) & 0x3F];
+        out[1] = k_encode_table[(bits >> 12) & 0x3F];
+        out[2] = rem_bytes == 2 ? k_encode_table[(bits >> 6) & 0x3F] : '=';
+        out[3] = '=';
     }
     return str;
 }
@@ -143,6 +159,33 @@ const std::size_t k_decode_table[] = {
     k_bad_char, k_bad_char, k_bad_char, k_bad_char, k_bad_char,
     k_bad_char, k_bad_char, k_bad_char // all 256!
 };
+
+Error make_bad_character_error(char c, std::size_t position);
+
+// Block decoders decode whole four character groups of clean base 64 text
+// (no whitespace, padding or invalid characters), they stop before the first
+// group which is not clean, or when there's no room for another group.
+// @return number of characters decoded, which is always a multiple of four
+using BlockDecoder = std::size_t(*)
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end);
+
+/** Decodes using the fastest block decoder the CPU supports, which is chosen
+ *  the first time this is called.
+ */
+std::size_t decode_blocks
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end);
+
+std::size_t decode_blocks_scalar
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end);
+
+#ifdef MACRO_BASE64_X86_SIMD
+std::size_t decode_blocks_sse41
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end);
+
+std::size_t decode_blocks_avx2
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end);
+#endif
+
 } // end of <anonymous> namespace
 
 ByteBuffer decode(const std::string & str) {
@@ -151,7 +194,6 @@ ByteBuffer decode(const std::string & str) {
 }
 
 ByteBuffer decode(const std::string & str, ByteBuffer & cache_data) {
-    using Byte = ByteBuffer::value_type;
     // the string must be divisible by four
     if (str.length() % 4 != 0) {
         throw Error("String not divisible by four.\n\"" + str + "\"\n"
@@ -162,7 +204,7 @@ ByteBuffer decode(const std::string & str, ByteBuffer & cache_data) {
     // swaping can prevent reallocation
     out_data.swap(cache_data);
     out_data.clear();
-    out_data.reserve((str.length() / 4)*3);
+    if (str.empty()) return out_data;
 
     // check padding characters (limit 2)
     std::size_t rem_bytes = 0;
@@ -171,86 +213,340 @@ ByteBuffer decode(const std::string & str, ByteBuffer & cache_data) {
         if (rem_bytes == 3)
             throw Error("Too many padding characters.");
     }
+    out_data.resize((str.length() / 4)*3 - rem_bytes);
+
+    // every group, but a padded last one, is decoded in blocks
+    const std::size_t block_length = str.length() - (rem_bytes == 0 ? 0 : 4);
+    const char * beg = str.data();
+    UInt8 * out = out_data.data();
+    const std::size_t decoded = decode_blocks
+        (beg, beg + block_length, out, out + (block_length / 4)*3);
+    if (decoded != block_length) {
+        // only stops early on a bad character
+        std::size_t i = decoded;
+        while (k_decode_table[static_cast<unsigned char>(str[i])] != k_bad_char) ++i;
+        throw make_bad_character_error(str[i], i);
+    }
 
-    for (std::size_t i = 0; i != str.length() - rem_bytes; i++) {
-        // valid base 64 character?
-        std::size_t val = k_decode_table[std::size_t(str[i])];
-        if (val == k_bad_char) {
-            throw Error("Bad character found found at position: " +
-                        std::to_string(i) + " which is \"" + str[i] +
-                        "\" (code: " + std::to_string(int(str[i])) + ")");
-        }
-        // which step are we on, there are four base 64 numbers per chunk
+    if (rem_bytes != 0) {
         // first bits are the most significant last -> least
-        switch (i % 4) {
-        case 0:
-            // first six bits of the first byte
-            out_data.push_back(Byte(val));
-            out_data.back() <<= 2;
-            break;
-        case 1:
-            // last two bits of the first byte, first four of the second
-            out_data.back() |= (val >> 4);
-            // these first four bits make up the more significant digits
-            out_data.push_back(Byte((val & 0x0F) << 4));
-            break;
-        case 2:
-            // last four bits of the second byte
-            out_data.back() |= val >> 2;
-            // first two bits of the third byte
-            out_data.push_back(Byte((val & 0x03) << 6));
-            break;
-        case 3:
-            // last six bits of the third byte
-            out_data.back() |= val;
-            break;
-        default:
-            assert(false);
-            break;
+        unsigned bits = 0;
+        for (std::size_t i = block_length; i != str.length() - rem_bytes; ++i) {
+            std::size_t val = k_decode_table[static_cast<unsigned char>(str[i])];
+            if (val == k_bad_char)
+                throw make_bad_character_error(str[i], i);
+            bits |= unsigned(val) << (18 - 6*(i - block_length));
         }
+        out += (block_length / 4)*3;
+        out[0] = UInt8(bits >> 16);
+        if (rem_bytes == 1)
+            out[1] = UInt8(bits >> 8);
     }
     return out_data;
 } // end of decode function
 
+std::size_t Decoder::decode
+    (const char *& beg, const char * end, UInt8 * out, std::size_t out_size)
+{
+    UInt8 * out_itr = out;
+    UInt8 * out_end = out + out_size;
+    // characters to read one at a time, before trying blocks again
+    int scalar_count = 0;
+    while (beg != end && out_itr != out_end) {
+        if (m_group_position == 0 && m_padding == 0 && scalar_count == 0) {
+            const std::size_t length = decode_blocks(beg, end, out_itr, out_end);
+            beg      += length;
+            m_position += length;
+            out_itr  += (length / 4)*3;
+            // the next group needs a closer look (or there's no room for it)
+            scalar_count = 4;
+            continue;
+        }
+        if (scalar_count != 0) --scalar_count;
+
+        const auto c = static_cast<unsigned char>(*beg++);
+        const std::size_t position = m_position++;
+        // the same characters clean_string would remove from tile data
+        if (c <= ' ' || c > '~') continue;
+        if (c == '=') {
+            if (m_group_position < 2)
+                throw Error("Padding found before the end of a four character "
+                            "group, at position: " + std::to_string(position));
+            ++m_padding;
+            if (++m_group_position == 4) {
+                // bits left over from padded groups are always zero
+                m_group_position = 0;
+                m_bit_count = 0;
+            }
+            continue;
+        }
+        const std::size_t val = k_decode_table[c];
+        if (val == k_bad_char || m_padding != 0)
+            throw make_bad_character_error(char(c), position);
+        m_group_position = (m_group_position + 1) % 4;
+        m_bits = (m_bits << 6) | unsigned(val);
+        m_bit_count += 6;
+        if (m_bit_count >= 8) {
+            m_bit_count -= 8;
+            *out_itr++ = UInt8(m_bits >> m_bit_count);
+        }
+    }
+    return std::size_t(out_itr - out);
+}
+
+void Decoder::finish() const {
+    if (m_group_position != 0) {
+        throw Error("String not divisible by four.\n"
+                    "of length: " + std::to_string(m_position));
+    }
+}
+
 namespace /* anonymous */ {
 
-void encode_chunk
-    (const ByteBuffer & data, std::string & str,
-     std::size_t chunk_index, std::size_t chunk_size)
+std::size_t encode_blocks(const UInt8 * beg, const UInt8 * end, char * out) {
+    static const BlockEncoder k_encoder = [] () -> BlockEncoder {
+#       ifdef MACRO_BASE64_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2" )) return encode_blocks_avx2;
+        if (__builtin_cpu_supports("ssse3")) return encode_blocks_ssse3;
+#       endif
+        return encode_blocks_scalar;
+    } ();
+    return k_encoder(beg, end, out);
+}
+
+std::size_t encode_blocks_scalar(const UInt8 * beg, const UInt8 * end, char * out) {
+    const UInt8 * itr = beg;
+    while (end - itr >= 3) {
+        // first is most significant, last -> least
+        const unsigned bits = (unsigned(itr[0]) << 16) | (unsigned(itr[1]) << 8) | itr[2];
+        out[0] = k_encode_table[(bits >> 18) & 0x3F];
+        out[1] = k_encode_table[(bits >> 12) & 0x3F];
+        out[2] = k_encode_table[(bits >>  6) & 0x3F];
+        out[3] = k_encode_table[ bits        & 0x3F];
+        out += 4;
+        itr += 3;
+    }
+    return std::size_t(itr - beg);
+}
+
+#ifdef MACRO_BASE64_X86_SIMD
+// Both vector encoders work the same way (per 128 bit lane):
+// - each three bytes are shuffled into a 32 bit word, where two 16 bit
+//   multiplies move the four six bit values into their own bytes
+// - values are mapped to characters by adding an offset, which is found by
+//   looking up which of the alphabet's ranges the value falls in
+// Each 12 bytes become 16 characters, though all 16 bytes are loaded, so
+// there must always be 4 bytes more to read.
+
+__attribute__((target("ssse3")))
+inline __m128i encode_lane(__m128i in) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i hi = _mm_mulhi_epu16(
+        _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    const __m128i lo = _mm_mullo_epi16(
+        _mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    const __m128i values = _mm_or_si128(hi, lo);
+    // 0 for a-z, 1 to 10 for 0-9, 11 for '+', 12 for '/' and 13 for A-Z
+    __m128i range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    const __m128i is_upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+    range = _mm_or_si128(range, _mm_and_si128(is_upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(values, _mm_shuffle_epi8(shift_lut, range));
+}
+
+__attribute__((target("ssse3")))
+std::size_t encode_blocks_ssse3(const UInt8 * beg, const UInt8 * end, char * out) {
+    const UInt8 * itr = beg;
+    while (end - itr >= 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(itr));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), encode_lane(in));
+        itr += 12;
+        out += 16;
+    }
+    return std::size_t(itr - beg) + encode_blocks_scalar(itr, end, out);
+}
+
+__attribute__((target("avx2")))
+std::size_t encode_blocks_avx2(const UInt8 * beg, const UInt8 * end, char * out) {
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    const __m256i order = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    const UInt8 * itr = beg;
+    while (end - itr >= 28) {
+        // each lane gets its own 12 bytes
+        const __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(itr))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(itr + 12)), 1);
+        const __m256i words = _mm256_shuffle_epi8(in, order);
+        const __m256i hi = _mm256_mulhi_epu16(
+            _mm256_and_si256(words, _mm256_set1_epi32(0x0FC0FC00)),
+            _mm256_set1_epi32(0x04000040));
+        const __m256i lo = _mm256_mullo_epi16(
+            _mm256_and_si256(words, _mm256_set1_epi32(0x003F03F0)),
+            _mm256_set1_epi32(0x01000010));
+        const __m256i values = _mm256_or_si256(hi, lo);
+        __m256i range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+        const __m256i is_upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+        range = _mm256_or_si256(range, _mm256_and_si256(is_upper, _mm256_set1_epi8(13)));
+        const __m256i chars = _mm256_add_epi8(values, _mm256_shuffle_epi8(shift_lut, range));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), chars);
+        itr += 24;
+        out += 32;
+    }
+    return std::size_t(itr - beg) + encode_blocks_ssse3(itr, end, out);
+}
+#endif
+
+Error make_bad_character_error(char c, std::size_t position) {
+    return Error("Bad character found found at position: " +
+                 std::to_string(position) + " which is \"" + c +
+                 "\" (code: " + std::to_string(int(c)) + ")");
+}
+
+std::size_t decode_blocks
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end)
+{
+    static const BlockDecoder k_decoder = [] () -> BlockDecoder {
+#       ifdef MACRO_BASE64_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"  )) return decode_blocks_avx2;
+        if (__builtin_cpu_supports("sse4.1")) return decode_blocks_sse41;
+#       endif
+        return decode_blocks_scalar;
+    } ();
+    return k_decoder(beg, end, out, out_end);
+}
+
+std::size_t decode_blocks_scalar
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end)
 {
-    // does the chunk have size? if not there is nothing to append
-    if (chunk_size == 0) return;
-
-    // first is most significant, last -> least
-    unsigned v;
-    // first six bits of the first, trim leftmost 00's
-    v = unsigned((data[chunk_index + 0] & 0xFC) >> 2);
-    str += k_encode_table[v];
-    // last two bits of the first byte, first 4 of the next
-    v = unsigned((data[chunk_index + 0] & 0x03) << 4);
-    // if we reached the end of the chunk, save and quit
-    if (chunk_size == 1) {
-        str += k_encode_table[v];
-        return;
+    const char * itr = beg;
+    while (end - itr >= 4 && out_end - out >= 3) {
+        const std::size_t a = k_decode_table[static_cast<unsigned char>(itr[0])];
+        const std::size_t b = k_decode_table[static_cast<unsigned char>(itr[1])];
+        const std::size_t c = k_decode_table[static_cast<unsigned char>(itr[2])];
+        const std::size_t d = k_decode_table[static_cast<unsigned char>(itr[3])];
+        // valid values fit in six bits, the sentinel does not
+        if ((a | b | c | d) > 0x3F) break;
+        const std::size_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = UInt8(bits >> 16);
+        out[1] = UInt8(bits >>  8);
+        out[2] = UInt8(bits      );
+        out += 3;
+        itr += 4;
     }
+    return std::size_t(itr - beg);
+}
 
-    // encode second byte
-    v |= unsigned((data[chunk_index + 1] & 0xF0) >> 4);
-    str += k_encode_table[v];
-    // last four bits of the second, first two of the third
-    v = unsigned((data[chunk_index + 1] & 0x0F) << 2);
-    if (chunk_size == 2) {
-        str += k_encode_table[v];
-        return;
+#ifdef MACRO_BASE64_X86_SIMD
+// Both vector decoders work the same way (per 128 bit lane):
+// - characters are classified by their high and low nibbles, each looking up
+//   a bit set, any character where the two sets overlap is not base 64
+// - every base 64 character range is mapped to its values by adding an
+//   offset, again found by looking up the high nibble ('/' being the one
+//   character needing special treatment)
+// - four six bit values are packed into three bytes with two multiply adds,
+//   and then shuffled into big endian order
+// Each 16 characters become 12 bytes, though all 16 are stored, so there must
+// always be room for 16 bytes more.
+
+__attribute__((target("sse4.1")))
+std::size_t decode_blocks_sse41
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i order = _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+
+    const char * itr = beg;
+    while (end - itr >= 16 && out_end - out >= 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(itr));
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble_mask);
+        const __m128i lo_nibbles = _mm_and_si128(in, nibble_mask);
+        const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm_testz_si128(lo, hi)) break;
+
+        const __m128i is_slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(is_slash, hi_nibbles));
+        const __m128i values = _mm_add_epi8(in, roll);
+        const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(words, order));
+        itr += 16;
+        out += 12;
     }
+    return std::size_t(itr - beg) + decode_blocks_scalar(itr, end, out, out_end);
+}
 
-    // third and final byte
-    v |= unsigned((data[chunk_index + 2] & 0xC0) >> 6);
-    str += k_encode_table[v];
-    // last six bits of the third byte
-    v = unsigned(data[chunk_index + 2] & 0x3F);
-    str += k_encode_table[v];
-} // end of encode_chunk function
+__attribute__((target("avx2")))
+std::size_t decode_blocks_avx2
+    (const char * beg, const char * end, UInt8 * out, UInt8 * out_end)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i order = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    // brings both lanes' 12 bytes together
+    const __m256i lane_order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+
+    const char * itr = beg;
+    while (end - itr >= 32 && out_end - out >= 32) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(itr));
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble_mask);
+        const __m256i lo_nibbles = _mm256_and_si256(in, nibble_mask);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        const __m256i is_slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+        const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(is_slash, hi_nibbles));
+        const __m256i values = _mm256_add_epi8(in, roll);
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        const __m256i packed = _mm256_permutevar8x32_epi32(
+            _mm256_shuffle_epi8(words, order), lane_order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), packed);
+        itr += 32;
+        out += 24;
+    }
+    return std::size_t(itr - beg) + decode_blocks_sse41(itr, end, out, out_end);
+}
+#endif
 
 } // end of <anonymous> namespace
 
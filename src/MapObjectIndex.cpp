@@ -0,0 +1,232 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "MapObjectIndex.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cassert>
+
+namespace {
+
+using FloatRect = sf::FloatRect;
+
+// keeps the grid's memory in check for maps with far flung objects
+constexpr const int k_max_cells = 1 << 20;
+
+constexpr const float k_default_cell_size = 64.f;
+
+float right_of (const FloatRect & rect) { return rect.left + rect.width ; }
+float bottom_of(const FloatRect & rect) { return rect.top  + rect.height; }
+
+/** Like FloatRect::intersects, but edges count, so that objects without
+ *  area (like points) may still be found.
+ */
+bool overlaps(const FloatRect & lhs, const FloatRect & rhs);
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+/* static */ constexpr const int MapObjectIndex::k_tiles_per_cell;
+
+MapObjectIndex::MapObjectIndex
+    (const MapObjectStore & objects, sf::Vector2f tile_size)
+{
+    if (objects.empty()) return;
+
+    m_boxes.reserve(objects.size());
+    FloatRect all = bounding_box_of(objects[0]);
+    for (const MapObjectView & obj : objects) {
+        m_boxes.push_back(bounding_box_of(obj));
+        const FloatRect & box = m_boxes.back();
+        const float right  = std::max(right_of (all), right_of (box));
+        const float bottom = std::max(bottom_of(all), bottom_of(box));
+        all.left   = std::min(all.left, box.left);
+        all.top    = std::min(all.top , box.top );
+        all.width  = right  - all.left;
+        all.height = bottom - all.top ;
+    }
+
+    m_origin = sf::Vector2f(all.left, all.top);
+    m_cell_size = sf::Vector2f(
+        tile_size.x > 0.f ? tile_size.x*k_tiles_per_cell : k_default_cell_size,
+        tile_size.y > 0.f ? tile_size.y*k_tiles_per_cell : k_default_cell_size);
+    while (true) {
+        m_cells_across = int(std::floor(all.width  / m_cell_size.x)) + 1;
+        m_cells_down   = int(std::floor(all.height / m_cell_size.y)) + 1;
+        if (double(m_cells_across)*double(m_cells_down) <= double(k_max_cells))
+            break;
+        m_cell_size *= 2.f;
+    }
+
+    // count entries per cell, then place them
+    const auto cell_count = std::size_t(m_cells_across*m_cells_down);
+    m_cell_starts.assign(cell_count + 1, 0);
+    auto for_each_cell_of = [this](const FloatRect & box, auto && f) {
+        const CellPos first = cell_of(box.left, box.top);
+        const CellPos last  = cell_of(right_of(box), bottom_of(box));
+        for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            f(std::size_t(y*m_cells_across + x));
+        }}
+    };
+    for (const FloatRect & box : m_boxes) {
+        for_each_cell_of(box, [this](std::size_t cell)
+            { ++m_cell_starts[cell + 1]; });
+    }
+    std::partial_sum(m_cell_starts.begin(), m_cell_starts.end(),
+                     m_cell_starts.begin());
+    m_cell_entries.resize(m_cell_starts.back());
+    std::vector<std::uint32_t> fill_pos(m_cell_starts.begin(),
+                                        m_cell_starts.end() - 1);
+    for (std::size_t i = 0; i != m_boxes.size(); ++i) {
+        for_each_cell_of(m_boxes[i], [&](std::size_t cell)
+            { m_cell_entries[fill_pos[cell]++] = std::uint32_t(i); });
+    }
+}
+
+void MapObjectIndex::find_in
+    (const MapObjectStore & objects, const sf::FloatRect & area,
+     const MapObjectFilter & filter, IndexVector & out) const
+{ find(objects, area, filter, [](const FloatRect &) { return true; }, out); }
+
+void MapObjectIndex::find_at
+    (const MapObjectStore & objects, sf::Vector2f point,
+     const MapObjectFilter & filter, IndexVector & out) const
+{
+    find(objects, FloatRect(point.x, point.y, 0.f, 0.f), filter,
+         [](const FloatRect &) { return true; }, out);
+}
+
+void MapObjectIndex::find_near
+    (const MapObjectStore & objects, sf::Vector2f center, float radius,
+     const MapObjectFilter & filter, IndexVector & out) const
+{
+    if (radius < 0.f) return;
+    const FloatRect area(center.x - radius, center.y - radius,
+                         radius*2.f, radius*2.f);
+    find(objects, area, filter, [center, radius](const FloatRect & box) {
+        // distance to the box's nearest point
+        const float dx = std::max({ box.left - center.x, 0.f,
+                                    center.x - right_of(box) });
+        const float dy = std::max({ box.top - center.y, 0.f,
+                                    center.y - bottom_of(box) });
+        return dx*dx + dy*dy <= radius*radius;
+    }, out);
+}
+
+/* static */ sf::FloatRect MapObjectIndex::bounding_box_of
+    (const MapObjectView & obj)
+{
+    // tile objects' bounds were already moved to their top left corner when
+    // loaded
+    const FloatRect & rv = obj.bounds();
+    if (obj.point_count() == 0) return rv;
+
+    // points are relative to the object's position
+    const sf::Vector2f * points = obj.points();
+    float left = points[0].x, right  = left;
+    float top  = points[0].y, bottom = top;
+    for (const auto * pt = points; pt != points + obj.point_count(); ++pt) {
+        left   = std::min(left  , pt->x);
+        right  = std::max(right , pt->x);
+        top    = std::min(top   , pt->y);
+        bottom = std::max(bottom, pt->y);
+    }
+    return FloatRect(rv.left + left, rv.top + top, right - left, bottom - top);
+}
+
+void MapObjectIndex::swap(MapObjectIndex & rhs) {
+    m_boxes.swap(rhs.m_boxes);
+    std::swap(m_origin, rhs.m_origin);
+    std::swap(m_cell_size, rhs.m_cell_size);
+    std::swap(m_cells_across, rhs.m_cells_across);
+    std::swap(m_cells_down, rhs.m_cells_down);
+    m_cell_starts.swap(rhs.m_cell_starts);
+    m_cell_entries.swap(rhs.m_cell_entries);
+}
+
+/* private */ template <typename Func>
+    void MapObjectIndex::find
+    (const MapObjectStore & objects, const sf::FloatRect & area,
+     const MapObjectFilter & filter, Func && exact_test, IndexVector & out) const
+{
+    assert(objects.size() == m_boxes.size());
+    if (m_boxes.empty()) return;
+
+    const auto first_new = out.size();
+    const CellPos first = cell_of(area.left, area.top);
+    const CellPos last  = cell_of(right_of(area), bottom_of(area));
+    for (int y = first.y; y <= last.y; ++y) {
+    for (int x = first.x; x <= last.x; ++x) {
+        const auto cell = std::size_t(y*m_cells_across + x);
+        for (auto i = m_cell_starts[cell]; i != m_cell_starts[cell + 1]; ++i) {
+            const std::uint32_t obj_index = m_cell_entries[i];
+            const FloatRect & box = m_boxes[obj_index];
+            if (!overlaps(box, area)) continue;
+            // an object in several cells is only reported by the cell which
+            // has the top left corner of its overlap with the area
+            const CellPos owner = cell_of(std::max(box.left, area.left),
+                                          std::max(box.top , area.top ));
+            if (owner.x != x || owner.y != y) continue;
+            const MapObjectView obj = objects[obj_index];
+            if (!filter.group.empty() && obj.group() != filter.group)
+                continue;
+            if (!filter.type.empty() && obj.type() != filter.type)
+                continue;
+            if (!exact_test(box)) continue;
+            out.push_back(obj_index);
+        }
+    }}
+    // report in document order
+    std::sort(out.begin() + std::ptrdiff_t(first_new), out.end());
+}
+
+/* private */ MapObjectIndex::CellPos MapObjectIndex::cell_of
+    (float x, float y) const
+{
+    // clamp before converting, areas may reach far past the grid
+    const float fx = std::floor((x - m_origin.x) / m_cell_size.x);
+    const float fy = std::floor((y - m_origin.y) / m_cell_size.y);
+    CellPos rv;
+    rv.x = int(std::min(std::max(fx, 0.f), float(m_cells_across - 1)));
+    rv.y = int(std::min(std::max(fy, 0.f), float(m_cells_down   - 1)));
+    return rv;
+}
+
+} // end of tmap namespace
+
+namespace {
+
+bool overlaps(const FloatRect & lhs, const FloatRect & rhs) {
+    return lhs.left <= right_of (rhs) && rhs.left <= right_of (lhs) &&
+           lhs.top  <= bottom_of(rhs) && rhs.top  <= bottom_of(lhs);
+}
+
+} // end of <anonymous> namespace
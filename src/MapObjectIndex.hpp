@@ -0,0 +1,101 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/MapObjectStore.hpp>
+
+#include <SFML/Graphics/Rect.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace tmap {
+
+/** Spatial index over a map's objects. @n
+ *  Objects are indexed by their bounding boxes on a uniform grid, whose
+ *  cells are a whole number of map tiles across. Each object is entered
+ *  into every cell its box touches. Queries visit only the cells their area
+ *  touches, and report each object at most once.
+ */
+class MapObjectIndex {
+public:
+    using IndexVector = std::vector<std::size_t>;
+
+    static constexpr const int k_tiles_per_cell = 4;
+
+    MapObjectIndex() {}
+
+    /** @param objects   objects to index, the same store must be passed to
+     *                   queries
+     *  @param tile_size size of the map's tiles in pixels
+     */
+    MapObjectIndex(const MapObjectStore & objects, sf::Vector2f tile_size);
+
+    /** Appends indices of objects whose bounding box overlaps the area. */
+    void find_in(const MapObjectStore &, const sf::FloatRect & area,
+                 const MapObjectFilter &, IndexVector & out) const;
+
+    /** Appends indices of objects whose bounding box contains the point. */
+    void find_at(const MapObjectStore &, sf::Vector2f point,
+                 const MapObjectFilter &, IndexVector & out) const;
+
+    /** Appends indices of objects whose bounding box is within radius of
+     *  the center.
+     */
+    void find_near(const MapObjectStore &, sf::Vector2f center,
+                   float radius, const MapObjectFilter &, IndexVector & out) const;
+
+    /** @returns bounding box of any map object, in pixels */
+    static sf::FloatRect bounding_box_of(const MapObjectView &);
+
+    void swap(MapObjectIndex &);
+
+private:
+    struct CellPos { int x, y; };
+
+    // each object overlapping the area is passed to f once, objects are
+    // then checked against the filter and exact test
+    template <typename Func>
+    void find(const MapObjectStore &, const sf::FloatRect & area,
+              const MapObjectFilter &, Func && exact_test, IndexVector & out) const;
+
+    // clamped to the grid
+    CellPos cell_of(float x, float y) const;
+
+    std::vector<sf::FloatRect> m_boxes;
+    sf::Vector2f m_origin;
+    sf::Vector2f m_cell_size;
+    int m_cells_across = 0;
+    int m_cells_down = 0;
+    // object indices by cell, cell i's are in [starts[i] starts[i + 1])
+    std::vector<std::uint32_t> m_cell_starts;
+    std::vector<std::uint32_t> m_cell_entries;
+};
+
+} // end of tmap namespace
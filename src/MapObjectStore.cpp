@@ -0,0 +1,298 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include <tmap/MapObjectStore.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+namespace {
+
+using Error = std::runtime_error;
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+std::string_view MapObjectView::name() const
+    { return m_store->text_of(m_store->m_names[m_index]); }
+
+std::string_view MapObjectView::type() const
+    { return m_store->text_of(m_store->m_types[m_index]); }
+
+const sf::FloatRect & MapObjectView::bounds() const
+    { return m_store->m_bounds[m_index]; }
+
+MapObjectView::ShapeType MapObjectView::shape_type() const
+    { return m_store->m_shape_types[m_index]; }
+
+int MapObjectView::local_tile_id() const
+    { return m_store->m_local_tile_ids[m_index]; }
+
+const MapObjectView::TileSetPtr & MapObjectView::tile_set() const {
+    static const TileSetPtr k_no_tile_set;
+    auto idx = m_store->m_tile_set_indices[m_index];
+    if (idx == MapObjectStore::k_no_tile_set) return k_no_tile_set;
+    return m_store->m_tile_sets[std::size_t(idx)];
+}
+
+std::size_t MapObjectView::point_count() const {
+    const auto & range = m_store->m_point_ranges[m_index];
+    return range.end - range.begin;
+}
+
+const sf::Vector2f * MapObjectView::points() const
+    { return m_store->m_points.data() + m_store->m_point_ranges[m_index].begin; }
+
+std::size_t MapObjectView::property_count() const {
+    const auto & range = m_store->m_property_ranges[m_index];
+    return range.end - range.begin;
+}
+
+MapObjectView::PropertyPair MapObjectView::property(std::size_t i) const {
+    assert(i < property_count());
+    const auto & ref = m_store->m_properties
+        [m_store->m_property_ranges[m_index].begin + i];
+    return PropertyPair(m_store->text_of(ref.name), m_store->text_of(ref.value));
+}
+
+bool MapObjectView::find_property
+    (std::string_view name, std::string_view & value) const
+{
+    const auto & range = m_store->m_property_ranges[m_index];
+    auto beg = m_store->m_properties.begin() + range.begin;
+    auto end = m_store->m_properties.begin() + range.end;
+    auto itr = std::lower_bound(beg, end, name,
+        [this](const MapObjectStore::PropertyRef & ref, std::string_view name)
+        { return m_store->text_of(ref.name) < name; });
+    if (itr == end || m_store->text_of(itr->name) != name) return false;
+    value = m_store->text_of(itr->value);
+    return true;
+}
+
+std::string_view MapObjectView::group() const {
+    return m_store->text_of
+        (m_store->m_group_names[std::size_t(m_store->m_groups[m_index])]);
+}
+
+MapObject MapObjectView::to_map_object() const {
+    MapObject rv;
+    rv.name          = std::string(name());
+    rv.type          = std::string(type());
+    rv.bounds        = bounds();
+    rv.shape_type    = shape_type();
+    rv.local_tile_id = local_tile_id();
+    rv.tile_set      = tile_set();
+    rv.points.assign(points(), points() + point_count());
+    for (std::size_t i = 0; i != property_count(); ++i) {
+        auto pair = property(i);
+        // already in order, so each insert goes at the end
+        rv.custom_properties.emplace_hint(rv.custom_properties.end(),
+            std::string(pair.first), std::string(pair.second));
+    }
+    return rv;
+}
+
+// ----------------------------------------------------------------------------
+
+/* static */ constexpr const std::int32_t MapObjectStore::k_no_tile_set;
+
+MapObjectStore::MapObjectStore(std::pmr::memory_resource * resource):
+    m_text            (resource),
+    m_properties      (resource),
+    m_points          (resource),
+    m_tile_sets       (resource),
+    m_group_names     (resource),
+    m_bounds          (resource),
+    m_names           (resource),
+    m_types           (resource),
+    m_shape_types     (resource),
+    m_local_tile_ids  (resource),
+    m_tile_set_indices(resource),
+    m_property_ranges (resource),
+    m_point_ranges    (resource),
+    m_groups          (resource)
+{}
+
+void MapObjectStore::add_group(std::string_view name)
+    { m_group_names.push_back(add_text(name)); }
+
+std::size_t MapObjectStore::add_object() {
+    if (m_group_names.empty()) add_group("");
+
+    const auto property_end = std::uint32_t(m_properties.size());
+    const auto point_end    = std::uint32_t(m_points.size());
+    m_bounds          .emplace_back();
+    m_names           .emplace_back();
+    m_types           .emplace_back();
+    m_shape_types     .push_back(MapObject::k_invalid_shape);
+    m_local_tile_ids  .push_back(0);
+    m_tile_set_indices.push_back(k_no_tile_set);
+    m_property_ranges .push_back(Range { property_end, property_end });
+    m_point_ranges    .push_back(Range { point_end, point_end });
+    m_groups          .push_back(std::int32_t(m_group_names.size()) - 1);
+    return last();
+}
+
+void MapObjectStore::set_name(std::string_view name)
+    { m_names[last()] = add_text(name); }
+
+void MapObjectStore::set_type(std::string_view type)
+    { m_types[last()] = add_text(type); }
+
+void MapObjectStore::set_bounds(const sf::FloatRect & bounds)
+    { m_bounds[last()] = bounds; }
+
+void MapObjectStore::set_shape_type(ShapeType shape_type)
+    { m_shape_types[last()] = shape_type; }
+
+void MapObjectStore::set_tile(const TileSetPtr & tile_set, int local_tile_id) {
+    m_local_tile_ids[last()] = local_tile_id;
+    if (!tile_set) {
+        m_tile_set_indices[last()] = k_no_tile_set;
+        return;
+    }
+    // maps have few tilesets, and objects using the same one tend to be
+    // loaded together
+    auto itr = std::find(m_tile_sets.rbegin(), m_tile_sets.rend(), tile_set);
+    if (itr == m_tile_sets.rend()) {
+        m_tile_sets.push_back(tile_set);
+        m_tile_set_indices[last()] = std::int32_t(m_tile_sets.size()) - 1;
+    } else {
+        m_tile_set_indices[last()] =
+            std::int32_t(std::distance(itr, m_tile_sets.rend())) - 1;
+    }
+}
+
+void MapObjectStore::add_property(std::string_view name, std::string_view value) {
+    // the last object's properties are at the end, and are kept in order
+    Range & range = m_property_ranges[last()];
+    auto beg = m_properties.begin() + range.begin;
+    auto itr = std::lower_bound(beg, m_properties.end(), name,
+        [this](const PropertyRef & ref, std::string_view name)
+        { return text_of(ref.name) < name; });
+    if (itr != m_properties.end() && text_of(itr->name) == name) return;
+
+    const auto pos = itr - m_properties.begin();
+    PropertyRef ref;
+    ref.name  = add_text(name );
+    ref.value = add_text(value);
+    m_properties.insert(m_properties.begin() + pos, ref);
+    ++range.end;
+}
+
+void MapObjectStore::add_point(const sf::Vector2f & pt) {
+    m_points.push_back(pt);
+    ++m_point_ranges[last()].end;
+}
+
+void MapObjectStore::reserve_points(std::size_t additional)
+    { m_points.reserve(m_points.size() + additional); }
+
+void MapObjectStore::append(const MapObjectStore & rhs) {
+    assert(&rhs != this);
+    if (m_text.size() + rhs.m_text.size() > std::size_t(UINT32_MAX)) {
+        throw Error("MapObjectStore::append: too much text in map objects.");
+    }
+    const auto text_offset     = std::uint32_t(m_text.size());
+    const auto property_offset = std::uint32_t(m_properties.size());
+    const auto point_offset    = std::uint32_t(m_points.size());
+    const auto group_offset    = std::int32_t(m_group_names.size());
+    auto move_text = [text_offset](TextRef ref)
+        { ref.offset += text_offset; return ref; };
+    auto move_range = [](Range range, std::uint32_t offset)
+        { range.begin += offset; range.end += offset; return range; };
+
+    // tileset indices are only meaningful to the store they are from
+    std::vector<std::int32_t> tile_set_indices;
+    tile_set_indices.reserve(rhs.m_tile_sets.size());
+    for (const auto & tile_set : rhs.m_tile_sets) {
+        auto itr = std::find(m_tile_sets.begin(), m_tile_sets.end(), tile_set);
+        if (itr == m_tile_sets.end())
+            itr = m_tile_sets.insert(itr, tile_set);
+        tile_set_indices.push_back(std::int32_t(itr - m_tile_sets.begin()));
+    }
+
+    m_text.append(rhs.m_text);
+    for (const PropertyRef & ref : rhs.m_properties) {
+        PropertyRef moved;
+        moved.name  = move_text(ref.name );
+        moved.value = move_text(ref.value);
+        m_properties.push_back(moved);
+    }
+    m_points     .insert(m_points     .end(), rhs.m_points     .begin(), rhs.m_points     .end());
+    for (const TextRef & ref : rhs.m_group_names)
+        m_group_names.push_back(move_text(ref));
+
+    for (std::size_t i = 0; i != rhs.size(); ++i) {
+        const std::int32_t tile_set_index = rhs.m_tile_set_indices[i];
+        m_bounds          .push_back(rhs.m_bounds[i]);
+        m_names           .push_back(move_text(rhs.m_names[i]));
+        m_types           .push_back(move_text(rhs.m_types[i]));
+        m_shape_types     .push_back(rhs.m_shape_types[i]);
+        m_local_tile_ids  .push_back(rhs.m_local_tile_ids[i]);
+        m_tile_set_indices.push_back(tile_set_index == k_no_tile_set ? k_no_tile_set
+            : tile_set_indices[std::size_t(tile_set_index)]);
+        m_property_ranges .push_back(move_range(rhs.m_property_ranges[i], property_offset));
+        m_point_ranges    .push_back(move_range(rhs.m_point_ranges[i], point_offset));
+        m_groups          .push_back(rhs.m_groups[i] + group_offset);
+    }
+}
+
+void MapObjectStore::swap(MapObjectStore & rhs) {
+    assert(m_bounds.get_allocator() == rhs.m_bounds.get_allocator());
+    m_text            .swap(rhs.m_text            );
+    m_properties      .swap(rhs.m_properties      );
+    m_points          .swap(rhs.m_points          );
+    m_tile_sets       .swap(rhs.m_tile_sets       );
+    m_group_names     .swap(rhs.m_group_names     );
+    m_bounds          .swap(rhs.m_bounds          );
+    m_names           .swap(rhs.m_names           );
+    m_types           .swap(rhs.m_types           );
+    m_shape_types     .swap(rhs.m_shape_types     );
+    m_local_tile_ids  .swap(rhs.m_local_tile_ids  );
+    m_tile_set_indices.swap(rhs.m_tile_set_indices);
+    m_property_ranges .swap(rhs.m_property_ranges );
+    m_point_ranges    .swap(rhs.m_point_ranges    );
+    m_groups          .swap(rhs.m_groups          );
+}
+
+/* private */ MapObjectStore::TextRef MapObjectStore::add_text
+    (std::string_view text)
+{
+    if (m_text.size() + text.size() > std::size_t(UINT32_MAX)) {
+        throw Error("MapObjectStore::add_text: too much text in map objects.");
+    }
+    TextRef ref;
+    ref.offset = std::uint32_t(m_text.size());
+    ref.length = std::uint32_t(text.size());
+    m_text.append(text.data(), text.size());
+    return ref;
+}
+
+} // end of tmap namespace
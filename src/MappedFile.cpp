@@ -0,0 +1,160 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <utility>
+
+#ifdef MACRO_PLATFORM_LINUX
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+using Error = std::runtime_error;
+
+namespace {
+
+using UInt8 = tmap::MappedFile::UInt8;
+
+/** Maps the whole file, read only.
+ *  @return nullptr if the file could not be mapped (including when it is
+ *          empty, there is nothing to map then)
+ */
+void * map_file(const char * filename, std::size_t & size);
+
+void unmap_file(void * mapping, std::size_t size);
+
+std::vector<UInt8> read_file(const char * filename);
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+MappedFile::MappedFile(const char * filename) {
+    m_mapping = map_file(filename, m_size);
+    if (m_mapping) {
+        m_data = static_cast<const UInt8 *>(m_mapping);
+    } else {
+        m_read_contents = read_file(filename);
+        m_data = m_read_contents.data();
+        m_size = m_read_contents.size();
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_mapping) unmap_file(m_mapping, m_size);
+}
+
+MappedFile & MappedFile::operator = (MappedFile && rhs) {
+    if (this != &rhs) {
+        MappedFile temp(std::move(rhs));
+        swap(temp);
+    }
+    return *this;
+}
+
+void MappedFile::swap(MappedFile & rhs) {
+    // swapping vectors leaves their elements where they are, so m_data still
+    // points to the right place
+    std::swap(m_data   , rhs.m_data   );
+    std::swap(m_size   , rhs.m_size   );
+    std::swap(m_mapping, rhs.m_mapping);
+    m_read_contents.swap(rhs.m_read_contents);
+}
+
+} // end of tmap namespace
+
+namespace {
+
+#ifdef MACRO_PLATFORM_LINUX
+
+void * map_file(const char * filename, std::size_t & size) {
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd == -1) return nullptr;
+
+    void * mapping = nullptr;
+    struct stat file_status;
+    if (::fstat(fd, &file_status) == 0 && S_ISREG(file_status.st_mode) &&
+        file_status.st_size > 0)
+    {
+        size = std::size_t(file_status.st_size);
+        mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+        } else {
+            // files are parsed or inflated front to back, so read ahead
+            // aggressively, failing that is harmless
+            (void)::madvise(mapping, size, MADV_SEQUENTIAL);
+        }
+    }
+    // the mapping stays valid after its descriptor is closed
+    (void)::close(fd);
+    if (!mapping) size = 0;
+    return mapping;
+}
+
+void unmap_file(void * mapping, std::size_t size)
+    { (void)::munmap(mapping, size); }
+
+#else
+
+void * map_file(const char *, std::size_t & size) {
+    size = 0;
+    return nullptr;
+}
+
+void unmap_file(void *, std::size_t) {}
+
+#endif
+
+std::vector<UInt8> read_file(const char * filename) {
+    std::ifstream fin(filename, std::ifstream::binary);
+    if (!fin) {
+        throw Error(std::string("Failed to open file: \"") + filename +
+                    "\".");
+    }
+    // read to the end, rather than by the file's size, as files which could
+    // not be mapped (like pipes) may not know theirs
+    static constexpr const std::size_t k_piece_size = 65536;
+    std::vector<UInt8> contents;
+    while (fin) {
+        const std::size_t old_size = contents.size();
+        contents.resize(old_size + k_piece_size);
+        fin.read(reinterpret_cast<char *>(contents.data() + old_size),
+                 std::streamsize(k_piece_size));
+        contents.resize(old_size + std::size_t(fin.gcount()));
+    }
+    if (fin.bad())
+        throw Error(std::string("Failed to read file: \"") + filename + "\".");
+    return contents;
+}
+
+} // end of <anonymous> namespace
@@ -0,0 +1,80 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace tmap {
+
+/** The whole contents of a file, read only. Where the platform allows it
+ *  (MACRO_PLATFORM_LINUX) the file is mapped into memory, so that nothing is
+ *  copied until it is read, and the pages are shared through the OS's page
+ *  cache with any other process reading the same file. Elsewhere, or should
+ *  mapping fail, the file is simply read into memory.
+ */
+class MappedFile {
+public:
+    using UInt8 = unsigned char;
+
+    MappedFile() {}
+
+    /** @throws if the file cannot be opened or read */
+    explicit MappedFile(const char * filename);
+
+    explicit MappedFile(const std::string & filename):
+        MappedFile(filename.c_str()) {}
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile(MappedFile && rhs) { swap(rhs); }
+
+    ~MappedFile();
+
+    MappedFile & operator = (const MappedFile &) = delete;
+
+    MappedFile & operator = (MappedFile && rhs);
+
+    void swap(MappedFile & rhs);
+
+    const UInt8 * data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+    /** @return true if the contents are mapped, rather than read */
+    bool is_mapped() const { return m_mapping != nullptr; }
+
+private:
+    const UInt8 * m_data = nullptr;
+    std::size_t m_size = 0;
+    void * m_mapping = nullptr;
+    std::vector<UInt8> m_read_contents;
+};
+
+} // end of tmap namespace
@@ -0,0 +1,331 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include <tmap/ObjectGeometry.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+namespace {
+
+using Vector2f  = sf::Vector2f;
+using FloatRect = sf::FloatRect;
+using Segment   = tmap::ObjectGeometry::Segment;
+using Triangle  = tmap::ObjectGeometry::Triangle;
+using MapObject = tmap::MapObject;
+
+/** @returns z of the cross product of (a - o) and (b - o), positive if the
+ *           turn o -> a -> b goes one way, negative the other, zero if the
+ *           three are in a line
+ */
+float cross(const Vector2f & o, const Vector2f & a, const Vector2f & b);
+
+bool box_contains(const FloatRect &, const Vector2f &);
+
+/** Triangulates a simple polygon by ear clipping, works for either winding.
+ *  Polygons which are not simple (those which cross themselves) are
+ *  covered as well as they can be.
+ */
+void triangulate(const std::vector<Vector2f> & polygon, std::vector<Triangle> & out);
+
+bool segments_intersect(const Segment &, const Segment &);
+
+bool segment_intersects_box(const Vector2f & a, const Vector2f & b, const FloatRect &);
+
+bool ellipse_contains(const FloatRect & box, const Vector2f &);
+
+bool segment_intersects_ellipse(const Vector2f & a, const Vector2f & b, const FloatRect & box);
+
+// even-odd rule
+bool polygon_contains(const Segment * beg, const Segment * end, const Vector2f &);
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+ObjectGeometry::ObjectGeometry(const MapObjectStore & objects) {
+    m_boxes.reserve(objects.size());
+    m_shape_types.reserve(objects.size());
+    m_triangle_ranges.reserve(objects.size());
+    m_edge_ranges.reserve(objects.size());
+
+    std::vector<Vector2f> absolute;
+    for (const MapObjectView & obj : objects) {
+        const FloatRect & bounds = obj.bounds();
+        Range triangles, edges;
+        triangles.begin = triangles.end = std::uint32_t(m_triangles.size());
+        edges.begin = edges.end = std::uint32_t(m_edges.size());
+
+        absolute.clear();
+        for (std::size_t i = 0; i != obj.point_count(); ++i) {
+            absolute.push_back(obj.points()[i]
+                               + Vector2f(bounds.left, bounds.top));
+        }
+
+        FloatRect box = bounds;
+        if (!absolute.empty()) {
+            auto xs = std::minmax_element(absolute.begin(), absolute.end(),
+                [](const Vector2f & l, const Vector2f & r) { return l.x < r.x; });
+            auto ys = std::minmax_element(absolute.begin(), absolute.end(),
+                [](const Vector2f & l, const Vector2f & r) { return l.y < r.y; });
+            box = FloatRect(xs.first->x, ys.first->y, xs.second->x - xs.first->x,
+                            ys.second->y - ys.first->y);
+        }
+
+        switch (obj.shape_type()) {
+        case MapObject::k_polygon:
+            triangulate(absolute, m_triangles);
+            for (std::size_t i = 0; i != absolute.size(); ++i) {
+                m_edges.push_back(Segment { absolute[i],
+                    absolute[(i + 1) % absolute.size()] });
+            }
+            break;
+        case MapObject::k_polyline:
+            for (std::size_t i = 1; i < absolute.size(); ++i)
+                m_edges.push_back(Segment { absolute[i - 1], absolute[i] });
+            break;
+        case MapObject::k_rectangle: case MapObject::k_text: {
+            const Vector2f tl(box.left, box.top);
+            const Vector2f tr(box.left + box.width, box.top);
+            const Vector2f br(box.left + box.width, box.top + box.height);
+            const Vector2f bl(box.left, box.top + box.height);
+            m_triangles.push_back(Triangle { tl, tr, br });
+            m_triangles.push_back(Triangle { tl, br, bl });
+            for (const auto & edge : { Segment { tl, tr }, Segment { tr, br },
+                                       Segment { br, bl }, Segment { bl, tl } })
+            { m_edges.push_back(edge); }
+            }
+            break;
+        default: break;
+        }
+
+        triangles.end = std::uint32_t(m_triangles.size());
+        edges.end     = std::uint32_t(m_edges.size());
+        m_boxes.push_back(box);
+        m_shape_types.push_back(obj.shape_type());
+        m_triangle_ranges.push_back(triangles);
+        m_edge_ranges.push_back(edges);
+    }
+}
+
+bool ObjectGeometry::contains(std::size_t i, sf::Vector2f pt) const {
+    const FloatRect & box = m_boxes[i];
+    if (!box_contains(box, pt)) return false;
+    switch (m_shape_types[i]) {
+    case MapObject::k_rectangle: case MapObject::k_text:
+        return true;
+    case MapObject::k_ellipse:
+        return ellipse_contains(box, pt);
+    case MapObject::k_polygon:
+        return polygon_contains(edges(i), edges(i) + edge_count(i), pt);
+    default:
+        // no area
+        return false;
+    }
+}
+
+bool ObjectGeometry::intersects(std::size_t i, sf::Vector2f a, sf::Vector2f b) const {
+    const FloatRect & box = m_boxes[i];
+    if (!segment_intersects_box(a, b, box)) return false;
+    switch (m_shape_types[i]) {
+    case MapObject::k_ellipse:
+        return segment_intersects_ellipse(a, b, box);
+    case MapObject::k_polygon:
+        if (contains(i, a)) return true;
+        // fall through
+    case MapObject::k_polyline: {
+        const Segment seg { a, b };
+        return std::any_of(edges(i), edges(i) + edge_count(i),
+            [&seg](const Segment & edge) { return segments_intersect(seg, edge); });
+        }
+    default:
+        // rectangles, text and points are their boxes
+        return true;
+    }
+}
+
+void ObjectGeometry::swap(ObjectGeometry & rhs) {
+    m_boxes          .swap(rhs.m_boxes          );
+    m_shape_types    .swap(rhs.m_shape_types    );
+    m_triangle_ranges.swap(rhs.m_triangle_ranges);
+    m_edge_ranges    .swap(rhs.m_edge_ranges    );
+    m_triangles      .swap(rhs.m_triangles      );
+    m_edges          .swap(rhs.m_edges          );
+}
+
+} // end of tmap namespace
+
+namespace {
+
+bool point_in_triangle
+    (const Vector2f & a, const Vector2f & b, const Vector2f & c, const Vector2f & p);
+
+// p is known to be in line with segment [a b]
+bool on_segment(const Vector2f & a, const Vector2f & b, const Vector2f & p);
+
+float cross(const Vector2f & o, const Vector2f & a, const Vector2f & b)
+    { return (a.x - o.x)*(b.y - o.y) - (a.y - o.y)*(b.x - o.x); }
+
+bool box_contains(const FloatRect & box, const Vector2f & pt) {
+    return pt.x >= box.left && pt.x <= box.left + box.width &&
+           pt.y >= box.top  && pt.y <= box.top  + box.height;
+}
+
+void triangulate(const std::vector<Vector2f> & polygon, std::vector<Triangle> & out) {
+    if (polygon.size() < 3) return;
+
+    float area2 = 0.f;
+    for (std::size_t i = 0; i != polygon.size(); ++i)
+        area2 += cross(Vector2f(), polygon[i], polygon[(i + 1) % polygon.size()]);
+    const float winding = area2 < 0.f ? -1.f : 1.f;
+
+    std::vector<std::size_t> remaining(polygon.size());
+    for (std::size_t i = 0; i != remaining.size(); ++i) remaining[i] = i;
+
+    while (remaining.size() > 3) {
+        bool clipped = false;
+        const std::size_t n = remaining.size();
+        for (std::size_t i = 0; i != n && !clipped; ++i) {
+            const Vector2f & a = polygon[remaining[(i + n - 1) % n]];
+            const Vector2f & b = polygon[remaining[i]];
+            const Vector2f & c = polygon[remaining[(i + 1) % n]];
+            // reflex and degenerate corners are not ears
+            if (cross(a, b, c)*winding <= 0.f) continue;
+            bool empty = true;
+            for (std::size_t j = 0; j != n && empty; ++j) {
+                const auto k = remaining[j];
+                if (k == remaining[(i + n - 1) % n] || k == remaining[i] ||
+                    k == remaining[(i + 1) % n])
+                { continue; }
+                empty = !point_in_triangle(a, b, c, polygon[k]);
+            }
+            if (!empty) continue;
+            out.push_back(Triangle { a, b, c });
+            remaining.erase(remaining.begin() + std::ptrdiff_t(i));
+            clipped = true;
+        }
+        // no ears left, the polygon must cross itself, so cover the rest
+        // with a fan
+        if (!clipped) break;
+    }
+    for (std::size_t i = 1; i + 1 < remaining.size(); ++i) {
+        out.push_back(Triangle { polygon[remaining[0]], polygon[remaining[i]],
+                                 polygon[remaining[i + 1]] });
+    }
+}
+
+bool segments_intersect(const Segment & s, const Segment & t) {
+    const float d1 = cross(t.a, t.b, s.a);
+    const float d2 = cross(t.a, t.b, s.b);
+    const float d3 = cross(s.a, s.b, t.a);
+    const float d4 = cross(s.a, s.b, t.b);
+    if (((d1 > 0.f && d2 < 0.f) || (d1 < 0.f && d2 > 0.f)) &&
+        ((d3 > 0.f && d4 < 0.f) || (d3 < 0.f && d4 > 0.f)))
+    { return true; }
+    return (d1 == 0.f && on_segment(t.a, t.b, s.a)) ||
+           (d2 == 0.f && on_segment(t.a, t.b, s.b)) ||
+           (d3 == 0.f && on_segment(s.a, s.b, t.a)) ||
+           (d4 == 0.f && on_segment(s.a, s.b, t.b));
+}
+
+bool segment_intersects_box(const Vector2f & a, const Vector2f & b, const FloatRect & box) {
+    // Liang-Barsky clipping, edges count
+    float t0 = 0.f, t1 = 1.f;
+    const Vector2f d = b - a;
+    const float p[4] = { -d.x, d.x, -d.y, d.y };
+    const float q[4] = { a.x - box.left, box.left + box.width  - a.x,
+                         a.y - box.top , box.top  + box.height - a.y };
+    for (int i = 0; i != 4; ++i) {
+        if (p[i] == 0.f) {
+            if (q[i] < 0.f) return false;
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0.f) t0 = std::max(t0, t);
+        else            t1 = std::min(t1, t);
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+bool ellipse_contains(const FloatRect & box, const Vector2f & pt) {
+    const float rx = box.width*0.5f, ry = box.height*0.5f;
+    if (rx <= 0.f || ry <= 0.f) return false;
+    const float dx = (pt.x - (box.left + rx)) / rx;
+    const float dy = (pt.y - (box.top  + ry)) / ry;
+    return dx*dx + dy*dy <= 1.f;
+}
+
+bool segment_intersects_ellipse
+    (const Vector2f & a, const Vector2f & b, const FloatRect & box)
+{
+    const float rx = box.width*0.5f, ry = box.height*0.5f;
+    if (rx <= 0.f || ry <= 0.f) return false;
+    // in a space where the ellipse is the unit circle
+    const Vector2f center(box.left + rx, box.top + ry);
+    const Vector2f p((a.x - center.x) / rx, (a.y - center.y) / ry);
+    const Vector2f q((b.x - center.x) / rx, (b.y - center.y) / ry);
+    const Vector2f d = q - p;
+    const float len2 = d.x*d.x + d.y*d.y;
+    float t = 0.f;
+    if (len2 > 0.f)
+        t = std::min(std::max(-(p.x*d.x + p.y*d.y) / len2, 0.f), 1.f);
+    const Vector2f nearest(p.x + d.x*t, p.y + d.y*t);
+    return nearest.x*nearest.x + nearest.y*nearest.y <= 1.f;
+}
+
+bool polygon_contains(const Segment * beg, const Segment * end, const Vector2f & pt) {
+    bool inside = false;
+    for (const Segment * edge = beg; edge != end; ++edge) {
+        const Vector2f & a = edge->a;
+        const Vector2f & b = edge->b;
+        if (cross(a, b, pt) == 0.f && on_segment(a, b, pt)) return true;
+        if ((a.y > pt.y) == (b.y > pt.y)) continue;
+        const float x_at = a.x + (pt.y - a.y)*(b.x - a.x) / (b.y - a.y);
+        if (pt.x < x_at) inside = !inside;
+    }
+    return inside;
+}
+
+bool point_in_triangle
+    (const Vector2f & a, const Vector2f & b, const Vector2f & c, const Vector2f & p)
+{
+    const float d1 = cross(a, b, p);
+    const float d2 = cross(b, c, p);
+    const float d3 = cross(c, a, p);
+    const bool has_neg = d1 < 0.f || d2 < 0.f || d3 < 0.f;
+    const bool has_pos = d1 > 0.f || d2 > 0.f || d3 > 0.f;
+    return !(has_neg && has_pos);
+}
+
+bool on_segment(const Vector2f & a, const Vector2f & b, const Vector2f & p) {
+    return p.x >= std::min(a.x, b.x) && p.x <= std::max(a.x, b.x) &&
+           p.y >= std::min(a.y, b.y) && p.y <= std::max(a.y, b.y);
+}
+
+} // end of <anonymous> namespace
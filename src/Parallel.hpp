@@ -0,0 +1,107 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <system_error>
+#include <algorithm>
+#include <utility>
+
+namespace tmap {
+
+/** Calls f(i) for every i in [0, count), spread over as many threads as the
+ *  hardware offers, the calling thread included.
+ *
+ *  Calls are made in no particular order, so each should only touch state
+ *  which belongs to its own index. Once any call throws, no more calls are
+ *  started; after every thread has stopped, the first exception thrown is
+ *  rethrown on the calling thread.
+ *  @param count number of indices to call f on
+ *  @param f callable as f(std::size_t)
+ */
+template <typename Func>
+void parallel_for(std::size_t count, Func && f);
+
+/** Same as parallel_for(std::size_t, Func &&), but with no more than
+ *  max_threads threads, with one thread all calls are made in order.
+ */
+template <typename Func>
+void parallel_for(std::size_t count, std::size_t max_threads, Func && f);
+
+// ----------------------------------------------------------------------------
+
+template <typename Func>
+void parallel_for(std::size_t count, Func && f) {
+    parallel_for(count, std::size_t(std::thread::hardware_concurrency()),
+                 std::forward<Func>(f));
+}
+
+template <typename Func>
+void parallel_for(std::size_t count, std::size_t max_threads, Func && f) {
+    const std::size_t thread_count =
+        std::min(count, std::max(std::size_t(1), max_threads));
+    if (thread_count < 2) {
+        for (std::size_t i = 0; i != count; ++i) f(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next_index(0);
+    std::atomic<bool> has_failed(false);
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    auto work = [&] {
+        std::size_t i;
+        while (!has_failed && (i = next_index++) < count) {
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) first_error = std::current_exception();
+                has_failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count - 1);
+    try {
+        while (workers.size() != thread_count - 1)
+            workers.emplace_back(work);
+    } catch (std::system_error &) {
+        // fewer threads is fine, the calling thread picks up the slack
+    }
+    work();
+    for (auto & worker : workers) worker.join();
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+} // end of tmap namespace
@@ -0,0 +1,57 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "PropertyKeyTable.hpp"
+
+#include <cassert>
+
+namespace tmap {
+
+PropertyKey PropertyKeyTable::intern(const std::string_view & name) {
+    auto itr = m_ids.find(name);
+    if (itr != m_ids.end()) return PropertyKey(itr->second);
+
+    m_names.emplace_back(name);
+    const int id = int(m_names.size()) - 1;
+    m_ids.insert(std::make_pair(std::string_view(m_names.back()), id));
+    return PropertyKey(id);
+}
+
+PropertyKey PropertyKeyTable::find(const std::string_view & name) const {
+    auto itr = m_ids.find(name);
+    if (itr == m_ids.end()) return PropertyKey();
+    return PropertyKey(itr->second);
+}
+
+const std::string & PropertyKeyTable::name_of(PropertyKey key) const {
+    static const std::string k_empty;
+    if (!key.is_valid()) return k_empty;
+    assert(index_of(key) < m_names.size());
+    return m_names[index_of(key)];
+}
+
+} // end of tmap namespace
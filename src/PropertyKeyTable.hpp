@@ -0,0 +1,73 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/PropertyKey.hpp>
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace tmap {
+
+/** Map-wide table of interned property and tile type names. Each name is
+ *  stored exactly once, no matter how many tiles use it. @n
+ *  Names are never removed, so keys and name references stay valid for the
+ *  life of the table.
+ */
+class PropertyKeyTable {
+public:
+    /** @returns key for the given name, adding the name if it is new */
+    PropertyKey intern(const std::string_view & name);
+
+    /** @returns key for the given name, or an invalid key if no property or
+     *           type by that name was ever seen
+     */
+    PropertyKey find(const std::string_view & name) const;
+
+    /** @returns name for the given key, an empty string for invalid keys */
+    const std::string & name_of(PropertyKey key) const;
+
+    /** @returns number of names in the table (one more than the greatest
+     *           key's index)
+     */
+    std::size_t size() const { return m_names.size(); }
+
+    /** @returns dense index for the given (valid) key, in [0 size()) */
+    static std::size_t index_of(PropertyKey key)
+        { return std::size_t(key.m_id); }
+
+private:
+    // deque, so that the views used as lookup keys stay put as more names
+    // are added
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string_view, int> m_ids;
+};
+
+} // end of tmap namespace
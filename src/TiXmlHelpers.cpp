@@ -25,8 +25,10 @@
 *****************************************************************************/
 
 #include "TiXmlHelpers.hpp"
+#include "MappedFile.hpp"
 
 #include <tmap/ZLib.hpp>
+#include <tmap/ZStd.hpp>
 
 #include <SFML/System/Vector2.hpp>
 
@@ -83,32 +85,33 @@ bool check_file_exist(const std::string & filename) {
     return check_file_exist(filename.c_str());
 }
 
+/** Decompresses a whole file's contents, which may be ZLib, gzip or
+ *  Zstandard compressed, told apart by their first bytes, and parses them.
+ */
+tinyxml2::XMLError parse_compressed_xml
+    (tmap::TiXmlDocument & doc, const tmap::MappedFile & file);
+
 } // end of <anonymous> namespace
 
 namespace tmap {
 
 void load_xml_file(TiXmlDocument & doc, const char * filename) {
-    using namespace ZLib;
+    // files are parsed (or inflated) straight from their mappings, tinyxml2
+    // makes its own copy to parse in place
     tinyxml2::XMLError gv;
     // check if tmxz format, by extension
     if (cstr_ends_with(filename, ".tmxz")) {
-        ByteBuffer buff = dump_file_to_buffer(filename);
-        buff = ZLib::decompress(buff);
-        // parse as ASCII
-        gv = doc.Parse
-            (reinterpret_cast<const char *>(buff.data()), buff.size());
+        gv = parse_compressed_xml(doc, MappedFile(filename));
     } else {
         if (check_file_exist(filename)) {
-            gv = doc.LoadFile(filename);
+            MappedFile file(filename);
+            gv = doc.Parse
+                (reinterpret_cast<const char *>(file.data()), file.size());
         } else {
             std::string zfilename = filename;
             zfilename += "z";
             if (check_file_exist(zfilename)) {
-                ByteBuffer buff = dump_file_to_buffer(zfilename.c_str());
-                buff = ZLib::decompress(buff);
-                // parse as ASCII
-                gv = doc.Parse
-                    (reinterpret_cast<const char *>(buff.data()), buff.size());
+                gv = parse_compressed_xml(doc, MappedFile(zfilename));
             } else {
                 gv = tinyxml2::XML_ERROR_FILE_NOT_FOUND;
             }
@@ -161,4 +164,17 @@ bool cstr_ends_with(const char * haystack, const char * needle) {
     }
 }
 
+tinyxml2::XMLError parse_compressed_xml
+    (tmap::TiXmlDocument & doc, const tmap::MappedFile & file)
+{
+    ZLib::ByteBuffer no_cache;
+    // the inflater reads either a ZLib or gzip header
+    const ZLib::ByteBuffer buff =
+        ZStd::has_magic_number(file.data(), file.size()) ?
+        ZStd::decompress(file.data(), file.size(), no_cache) :
+        ZLib::decompress(file.data(), file.size(), no_cache);
+    // parse as ASCII
+    return doc.Parse(reinterpret_cast<const char *>(buff.data()), buff.size());
+}
+
 } // end of <anonymous> namespace
@@ -0,0 +1,252 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "TileCountTable.hpp"
+#include "TileFlagPlanes.hpp"
+
+#include <cassert>
+
+namespace {
+
+constexpr const int k_chunk_size = tmap::TileCountTable::k_chunk_size;
+
+// number of chunks needed to cover length tiles
+int chunks_for(int length)
+    { return (length + k_chunk_size - 1) / k_chunk_size; }
+
+/** Splits a layer local prefix bound (in [0 length]) into a chunk and a
+ *  position in that chunk (in [0 k_chunk_size]). The far edge maps onto the
+ *  last chunk, rather than one past it.
+ */
+void split_bound(int pos, int chunk_count, int & chunk, int & local);
+
+// Fenwick trees, which cover elements [1 size] of tree (tree[0] is unused)
+
+/** Turns plain values, in elements [1 size], into a Fenwick tree. */
+void fenwick_build(int * tree, int size);
+
+/** @returns sum of the values in [1 end] */
+int fenwick_prefix(const int * tree, int end);
+
+void fenwick_add(int * tree, int size, int pos, int delta);
+
+// step to the next element which covers more (for adds), or which covers
+// what comes before (for prefixes)
+int lowest_bit(int i) { return i & -i; }
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+/* static */ constexpr const int TileCountTable::k_chunk_size;
+
+TileCountTable::TileCountTable(const TileBitPlane & plane):
+    m_bounds(plane.bounds()),
+    m_chunks_across(chunks_for(m_bounds.width)),
+    m_chunks_down(chunks_for(m_bounds.height))
+{
+    static constexpr const int k_c = k_chunk_size;
+    m_local.resize(std::size_t(m_chunks_across*m_chunks_down*k_c*k_c), 0);
+    m_coarse.resize(std::size_t((m_chunks_across + 1)*(m_chunks_down + 1)), 0);
+    m_row_bands.resize
+        (std::size_t(m_chunks_down*k_c*(m_chunks_across + 1)), 0);
+    m_column_bands.resize
+        (std::size_t(m_chunks_across*k_c*(m_chunks_down + 1)), 0);
+
+    const TileCountTable & cthis = *this;
+    for (int cy = 0; cy != m_chunks_down  ; ++cy) {
+    for (int cx = 0; cx != m_chunks_across; ++cx) {
+        for (int ly = 1; ly <= k_c; ++ly) {
+            // cells outside of the plane always read as clear
+            const auto bits = plane.span(m_bounds.left + cx*k_c,
+                                         m_bounds.top  + cy*k_c + ly - 1, k_c);
+            int row_sum = 0;
+            for (int lx = 1; lx <= k_c; ++lx) {
+                row_sum += int((bits >> (lx - 1)) & 1);
+                local(cx, cy, lx, ly) =
+                    LocalCount(row_sum + cthis.local(cx, cy, lx, ly - 1));
+            }
+        }
+
+        // plain values first, these become trees below
+        for (int ly = 1; ly <= k_c; ++ly)
+            row_band_tree(cy, ly)[cx + 1] = local(cx, cy, k_c, ly);
+        for (int lx = 1; lx <= k_c; ++lx)
+            column_band_tree(cx, lx)[cy + 1] = local(cx, cy, lx, k_c);
+        coarse_row(cy + 1)[cx + 1] = local(cx, cy, k_c, k_c);
+    }}
+
+    for (int cy = 0; cy != m_chunks_down; ++cy) {
+        for (int ly = 1; ly <= k_c; ++ly)
+            fenwick_build(row_band_tree(cy, ly), m_chunks_across);
+    }
+    for (int cx = 0; cx != m_chunks_across; ++cx) {
+        for (int lx = 1; lx <= k_c; ++lx)
+            fenwick_build(column_band_tree(cx, lx), m_chunks_down);
+    }
+    // two dimensions: make each row a tree, then fold rows together the way
+    // a one dimensional tree folds elements
+    for (int i = 1; i <= m_chunks_down; ++i)
+        fenwick_build(coarse_row(i), m_chunks_across);
+    for (int i = 1; i <= m_chunks_down; ++i) {
+        const int parent = i + lowest_bit(i);
+        if (parent > m_chunks_down) continue;
+        for (int j = 1; j <= m_chunks_across; ++j)
+            coarse_row(parent)[j] += coarse_row(i)[j];
+    }
+}
+
+int TileCountTable::count(const sf::IntRect & region) const {
+    sf::IntRect clipped;
+    if (!region.intersects(m_bounds, clipped)) return 0;
+    const int x0 = clipped.left - m_bounds.left;
+    const int y0 = clipped.top  - m_bounds.top ;
+    const int x1 = x0 + clipped.width ;
+    const int y1 = y0 + clipped.height;
+    return prefix(x1, y1) - prefix(x0, y1) - prefix(x1, y0) + prefix(x0, y0);
+}
+
+void TileCountTable::add(int x, int y, int delta) {
+    static constexpr const int k_c = k_chunk_size;
+    if (!m_bounds.contains(x, y)) return;
+    x -= m_bounds.left;
+    y -= m_bounds.top ;
+    const int cx = x / k_c, lx0 = x % k_c;
+    const int cy = y / k_c, ly0 = y % k_c;
+
+    // the cell is counted by every prefix which extends past it
+    for (int ly = ly0 + 1; ly <= k_c; ++ly) {
+    for (int lx = lx0 + 1; lx <= k_c; ++lx) {
+        LocalCount & c = local(cx, cy, lx, ly);
+        c = LocalCount(c + delta);
+    }}
+    for (int ly = ly0 + 1; ly <= k_c; ++ly)
+        fenwick_add(row_band_tree(cy, ly), m_chunks_across, cx + 1, delta);
+    for (int lx = lx0 + 1; lx <= k_c; ++lx)
+        fenwick_add(column_band_tree(cx, lx), m_chunks_down, cy + 1, delta);
+    for (int i = cy + 1; i <= m_chunks_down; i += lowest_bit(i))
+        fenwick_add(coarse_row(i), m_chunks_across, cx + 1, delta);
+}
+
+/* private */ int TileCountTable::prefix(int x, int y) const {
+    if (m_chunks_across == 0 || m_chunks_down == 0) return 0;
+    int cx, lx, cy, ly;
+    split_bound(x, m_chunks_across, cx, lx);
+    split_bound(y, m_chunks_down  , cy, ly);
+    return coarse(cx, cy) + row_band(cy, ly, cx) + column_band(cx, lx, cy)
+           + local(cx, cy, lx, ly);
+}
+
+/* private */ TileCountTable::LocalCount & TileCountTable::local
+    (int cx, int cy, int lx, int ly)
+{
+    assert(lx > 0 && ly > 0);
+    return m_local[std::size_t(
+        ((cy*m_chunks_across + cx)*k_chunk_size + (ly - 1))*k_chunk_size
+        + (lx - 1))];
+}
+
+/* private */ TileCountTable::LocalCount TileCountTable::local
+    (int cx, int cy, int lx, int ly) const
+{
+    if (lx == 0 || ly == 0) return 0;
+    return const_cast<TileCountTable &>(*this).local(cx, cy, lx, ly);
+}
+
+/* private */ int TileCountTable::coarse(int cx, int cy) const {
+    int sum = 0;
+    for (int i = cy; i > 0; i -= lowest_bit(i))
+        sum += fenwick_prefix(coarse_row(i), cx);
+    return sum;
+}
+
+/* private */ int TileCountTable::row_band(int cy, int ly, int cx) const {
+    if (ly == 0) return 0;
+    return fenwick_prefix(row_band_tree(cy, ly), cx);
+}
+
+/* private */ int TileCountTable::column_band(int cx, int lx, int cy) const {
+    if (lx == 0) return 0;
+    return fenwick_prefix(column_band_tree(cx, lx), cy);
+}
+
+/* private */ int * TileCountTable::coarse_row(int i)
+    { return &m_coarse[std::size_t(i*(m_chunks_across + 1))]; }
+
+/* private */ int * TileCountTable::row_band_tree(int cy, int ly) {
+    assert(ly > 0);
+    return &m_row_bands[std::size_t(
+        (cy*k_chunk_size + (ly - 1))*(m_chunks_across + 1))];
+}
+
+/* private */ int * TileCountTable::column_band_tree(int cx, int lx) {
+    assert(lx > 0);
+    return &m_column_bands[std::size_t(
+        (cx*k_chunk_size + (lx - 1))*(m_chunks_down + 1))];
+}
+
+/* private */ const int * TileCountTable::coarse_row(int i) const
+    { return const_cast<TileCountTable &>(*this).coarse_row(i); }
+
+/* private */ const int * TileCountTable::row_band_tree(int cy, int ly) const
+    { return const_cast<TileCountTable &>(*this).row_band_tree(cy, ly); }
+
+/* private */ const int * TileCountTable::column_band_tree(int cx, int lx) const
+    { return const_cast<TileCountTable &>(*this).column_band_tree(cx, lx); }
+
+} // end of tmap namespace
+
+namespace {
+
+void split_bound(int pos, int chunk_count, int & chunk, int & local) {
+    assert(chunk_count > 0);
+    chunk = pos / k_chunk_size;
+    local = pos % k_chunk_size;
+    if (chunk == chunk_count) {
+        chunk = chunk_count - 1;
+        local = k_chunk_size;
+    }
+}
+
+void fenwick_build(int * tree, int size) {
+    for (int i = 1; i <= size; ++i) {
+        const int parent = i + lowest_bit(i);
+        if (parent <= size) tree[parent] += tree[i];
+    }
+}
+
+int fenwick_prefix(const int * tree, int end) {
+    int sum = 0;
+    for (int i = end; i > 0; i -= lowest_bit(i)) sum += tree[i];
+    return sum;
+}
+
+void fenwick_add(int * tree, int size, int pos, int delta) {
+    for (int i = pos; i <= size; i += lowest_bit(i)) tree[i] += delta;
+}
+
+} // end of <anonymous> namespace
@@ -0,0 +1,119 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <SFML/Graphics/Rect.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace tmap {
+
+class TileBitPlane;
+
+/** A summed-area table over one of a tile layer's bit planes, which counts
+ *  flagged cells in any rectangle with a handful of lookups. @n
+ *  @n
+ *  A single flat table would need a whole quarter of the layer rewritten
+ *  when a tile changes. Instead the layer is split into square chunks, and
+ *  the count of cells above and left of a position is the sum of four
+ *  parts:
+ *  - whole chunks above and left of the position's chunk (coarse table)
+ *  - whole chunks left, in the position's row of chunks (row bands)
+ *  - whole chunks above, in the position's column of chunks (column bands)
+ *  - cells inside the position's own chunk (per chunk table)
+ *  @n
+ *  Everything but the per chunk tables is kept in Fenwick (binary indexed)
+ *  trees over chunks. Changing one cell rewrites part of its chunk's table
+ *  and O(log) entries of each tree, which stays small however large the
+ *  layer is. Counting reads O(log) entries of each tree.
+ */
+class TileCountTable {
+public:
+    static constexpr const int k_chunk_size = 16;
+
+    TileCountTable() {}
+
+    /** Builds a table counting the plane's set cells. */
+    explicit TileCountTable(const TileBitPlane &);
+
+    /** @returns number of set cells in region, in map positions */
+    int count(const sf::IntRect & region) const;
+
+    /** Records that a single cell was set (delta = 1) or cleared
+     *  (delta = -1).
+     */
+    void add(int x, int y, int delta);
+
+    const sf::IntRect & bounds() const { return m_bounds; }
+
+private:
+    using LocalCount = std::uint16_t;
+
+    static_assert(k_chunk_size*k_chunk_size <= 0xFFFF,
+                  "per chunk counts must fit LocalCount");
+
+    // number of set cells in [0 x) by [0 y), layer local positions
+    int prefix(int x, int y) const;
+
+    // per chunk table: cells in [0 lx) by [0 ly) of chunk, lx, ly in [1 C]
+    LocalCount & local(int cx, int cy, int lx, int ly);
+    LocalCount local(int cx, int cy, int lx, int ly) const;
+
+    // coarse: whole chunks in [0 cx) by [0 cy)
+    int coarse(int cx, int cy) const;
+
+    // row band: rows [0 ly) of chunk row cy, chunks [0 cx)
+    int row_band(int cy, int ly, int cx) const;
+
+    // column band: columns [0 lx) of chunk column cx, chunks [0 cy)
+    int column_band(int cx, int lx, int cy) const;
+
+    // each of these is one Fenwick tree, elements are in [1 size]
+    int * coarse_row(int i);
+    int * row_band_tree(int cy, int ly);
+    int * column_band_tree(int cx, int lx);
+    const int * coarse_row(int i) const;
+    const int * row_band_tree(int cy, int ly) const;
+    const int * column_band_tree(int cx, int lx) const;
+
+    sf::IntRect m_bounds;
+    int m_chunks_across = 0;
+    int m_chunks_down = 0;
+
+    std::vector<LocalCount> m_local;
+    // a two dimensional Fenwick tree of whole chunk counts, one tree (over
+    // chunks across) for each row of its outer tree (over chunks down)
+    std::vector<int> m_coarse;
+    // one tree over chunks across for each row of each chunk row
+    std::vector<int> m_row_bands;
+    // one tree over chunks down for each column of each chunk column
+    std::vector<int> m_column_bands;
+};
+
+} // end of tmap namespace
@@ -0,0 +1,257 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "TileFlagPlanes.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+using Word = tmap::TileBitPlane::Word;
+
+constexpr const int k_word_bits = tmap::TileBitPlane::k_word_bits;
+
+/** @returns a word with the lowest n bits set, n in [0 k_word_bits] */
+Word low_bits(int n);
+
+int popcount(Word);
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+/* static */ constexpr const int TileBitPlane::k_word_bits;
+
+TileBitPlane::TileBitPlane(const TileMatrix & matrix, const GidFlags & gid_flags):
+    m_bounds(matrix.bounds()),
+    m_words_per_row((m_bounds.width + k_word_bits - 1) / k_word_bits)
+{
+    m_words.resize(std::size_t(m_words_per_row*m_bounds.height), 0);
+    std::vector<int> row_gids(std::size_t(m_bounds.width));
+    for (int y = 0; y != m_bounds.height; ++y) {
+        matrix.read_row(m_bounds.left, m_bounds.top + y, m_bounds.width,
+                        row_gids.data());
+        Word * row = m_words.data() + word_index(0, y);
+        for (int x = 0; x != m_bounds.width; ++x) {
+            if (!gid_flags(row_gids[std::size_t(x)])) continue;
+            row[x / k_word_bits] |= Word(1) << (x % k_word_bits);
+        }
+    }
+}
+
+bool TileBitPlane::test(int x, int y) const {
+    if (!m_bounds.contains(x, y)) return false;
+    x -= m_bounds.left;
+    y -= m_bounds.top;
+    return (m_words[word_index(x, y)] >> (x % k_word_bits)) & 1;
+}
+
+void TileBitPlane::set(int x, int y, bool value) {
+    if (!m_bounds.contains(x, y)) return;
+    x -= m_bounds.left;
+    y -= m_bounds.top;
+    const Word bit = Word(1) << (x % k_word_bits);
+    Word & word = m_words[word_index(x, y)];
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+TileBitPlane::Word TileBitPlane::span(int x, int y, int length) const {
+    length = std::min(std::max(length, 0), k_word_bits);
+    if (y < m_bounds.top || y >= m_bounds.top + m_bounds.height) return 0;
+    const int local_x = x - m_bounds.left;
+    const int first = std::max(local_x, 0);
+    const int last  = std::min(local_x + length, m_bounds.width);
+    Word rv = 0;
+    // a span straddles at most two words
+    for (int i = first; i < last; ) {
+        const int offset = i % k_word_bits;
+        const int taken  = std::min(k_word_bits - offset, last - i);
+        const Word bits  = (m_words[word_index(i, y - m_bounds.top)] >> offset)
+                           & low_bits(taken);
+        rv |= bits << (i - local_x);
+        i += taken;
+    }
+    return rv;
+}
+
+int TileBitPlane::count(const sf::IntRect & region) const {
+    sf::IntRect local;
+    if (!clip(region, local)) return 0;
+    int rv = 0;
+    for (int y = local.top; y != local.top + local.height; ++y) {
+        for_each_masked_word(y, local.left, local.left + local.width,
+            [&rv](Word word) { rv += popcount(word); return false; });
+    }
+    return rv;
+}
+
+bool TileBitPlane::any(const sf::IntRect & region) const {
+    sf::IntRect local;
+    if (!clip(region, local)) return false;
+    for (int y = local.top; y != local.top + local.height; ++y) {
+        if (for_each_masked_word(y, local.left, local.left + local.width,
+                                 [](Word word) { return word != 0; }))
+        { return true; }
+    }
+    return false;
+}
+
+/* private */ template <typename Func>
+    bool TileBitPlane::for_each_masked_word
+    (int row, int first, int last, Func && f) const
+{
+    assert(first < last);
+    const Word * words = m_words.data() + word_index(0, row);
+    const int first_word = first / k_word_bits;
+    const int last_word  = (last - 1) / k_word_bits;
+    const Word first_mask = ~low_bits(first % k_word_bits);
+    const Word last_mask  = low_bits(last - last_word*k_word_bits);
+    if (first_word == last_word)
+        return f(words[first_word] & first_mask & last_mask);
+
+    if (f(words[first_word] & first_mask)) return true;
+    for (int i = first_word + 1; i != last_word; ++i) {
+        if (f(words[i])) return true;
+    }
+    return f(words[last_word] & last_mask);
+}
+
+/* private */ bool TileBitPlane::clip
+    (const sf::IntRect & region, sf::IntRect & local) const
+{
+    if (!region.intersects(m_bounds, local)) return false;
+    local.left -= m_bounds.left;
+    local.top  -= m_bounds.top ;
+    return local.width > 0 && local.height > 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void TileFlagPlanes::add_plane
+    (GidFlagsPtr gid_flags, const TileMatrix & matrix, bool with_counts)
+{
+    Entry entry;
+    entry.plane = TileBitPlane(matrix, *gid_flags);
+    if (with_counts)
+        entry.counts = std::make_unique<TileCountTable>(entry.plane);
+    entry.gid_flags = std::move(gid_flags);
+    m_entries.emplace_back(std::move(entry));
+}
+
+void TileFlagPlanes::enable_counts(TileFlag flag) {
+    Entry * entry = find_entry(flag);
+    if (!entry || entry->counts) return;
+    entry->counts = std::make_unique<TileCountTable>(entry->plane);
+}
+
+void TileFlagPlanes::update
+    (const TileMatrix & matrix, int x, int y, int new_gid)
+{
+    if (rebuild_if_resized(matrix)) return;
+    for (Entry & entry : m_entries) {
+        const bool was_set = entry.plane.test(x, y);
+        const bool is_set  = (*entry.gid_flags)(new_gid);
+        if (was_set == is_set) continue;
+        entry.plane.set(x, y, is_set);
+        if (entry.counts)
+            entry.counts->add(x, y, is_set ? 1 : -1);
+    }
+}
+
+void TileFlagPlanes::update
+    (const TileMatrix & matrix, const std::vector<TileChange> & changes)
+{
+    if (changes.empty() || rebuild_if_resized(matrix)) return;
+    for (Entry & entry : m_entries) {
+        // each count update touches about a chunk's worth of cells, past a
+        // chunk's worth of changes per chunk a rebuild is cheaper
+        const auto & bounds = entry.plane.bounds();
+        const bool rebuild_counts = entry.counts &&
+            changes.size()*std::size_t(TileCountTable::k_chunk_size*TileCountTable::k_chunk_size)
+            > std::size_t(bounds.width)*std::size_t(bounds.height);
+        for (const TileChange & change : changes) {
+            const bool was_set = entry.plane.test(change.x, change.y);
+            const bool is_set  = (*entry.gid_flags)(change.new_gid);
+            if (was_set == is_set) continue;
+            entry.plane.set(change.x, change.y, is_set);
+            if (entry.counts && !rebuild_counts)
+                entry.counts->add(change.x, change.y, is_set ? 1 : -1);
+        }
+        if (rebuild_counts)
+            *entry.counts = TileCountTable(entry.plane);
+    }
+}
+
+const TileBitPlane * TileFlagPlanes::find_plane(TileFlag flag) const {
+    const Entry * entry = const_cast<TileFlagPlanes &>(*this).find_entry(flag);
+    return entry ? &entry->plane : nullptr;
+}
+
+const TileCountTable * TileFlagPlanes::find_counts(TileFlag flag) const {
+    const Entry * entry = const_cast<TileFlagPlanes &>(*this).find_entry(flag);
+    return entry ? entry->counts.get() : nullptr;
+}
+
+/* private */ TileFlagPlanes::Entry * TileFlagPlanes::find_entry(TileFlag flag) {
+    if (!flag.is_valid()) return nullptr;
+    if (index_of(flag) >= m_entries.size()) return nullptr;
+    return &m_entries[index_of(flag)];
+}
+
+/* private */ bool TileFlagPlanes::rebuild_if_resized(const TileMatrix & matrix) {
+    if (m_entries.empty()) return true;
+    if (m_entries.front().plane.bounds() == matrix.bounds()) return false;
+    for (Entry & entry : m_entries) {
+        entry.plane = TileBitPlane(matrix, *entry.gid_flags);
+        if (entry.counts)
+            *entry.counts = TileCountTable(entry.plane);
+    }
+    return true;
+}
+
+} // end of tmap namespace
+
+namespace {
+
+Word low_bits(int n) {
+    assert(n >= 0 && n <= k_word_bits);
+    if (n == k_word_bits) return ~Word(0);
+    return (Word(1) << n) - 1;
+}
+
+int popcount(Word word) {
+#   if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#   else
+    int rv = 0;
+    for (; word; word &= word - 1) ++rv;
+    return rv;
+#   endif
+}
+
+} // end of <anonymous> namespace
@@ -0,0 +1,177 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/TileFlag.hpp>
+
+#include "TileMatrix.hpp"
+#include "TileCountTable.hpp"
+
+#include <SFML/Graphics/Rect.hpp>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace tmap {
+
+/** Truth value of one flag for each gid of a map. Computed once per map load
+ *  and shared by every tile layer of that map.
+ */
+class GidFlags {
+public:
+    GidFlags() {}
+
+    /** @param flags_ indexed by gid */
+    explicit GidFlags(std::vector<bool> && flags_):
+        m_flags(std::move(flags_))
+    {}
+
+    /** @returns true if the flag is set for the given gid, gids out of range
+     *           (including "no tile") are never flagged
+     */
+    bool operator () (int gid) const {
+        if (gid < 0 || std::size_t(gid) >= m_flags.size()) return false;
+        return m_flags[std::size_t(gid)];
+    }
+
+private:
+    std::vector<bool> m_flags;
+};
+
+/** One bit for each cell of a tile layer, rows are padded to whole words.
+ *  Queries work a word (64 cells) at a time, counting with popcount. @n
+ *  Positions outside of the plane's bounds are never set.
+ */
+class TileBitPlane {
+public:
+    using Word = std::uint64_t;
+
+    static constexpr const int k_word_bits = 64;
+
+    TileBitPlane() {}
+
+    /** Builds a plane covering the matrix's bounds. */
+    TileBitPlane(const TileMatrix &, const GidFlags &);
+
+    bool test(int x, int y) const;
+
+    void set(int x, int y, bool value);
+
+    /** @returns bits for up to k_word_bits cells in a row, where bit i is
+     *           cell (x + i, y)
+     */
+    Word span(int x, int y, int length) const;
+
+    /** @returns number of set cells inside the region */
+    int count(const sf::IntRect & region) const;
+
+    /** @returns true if any cell inside the region is set */
+    bool any(const sf::IntRect & region) const;
+
+    const sf::IntRect & bounds() const { return m_bounds; }
+
+private:
+    // calls f(word & mask) for each word of plane local row, which covers
+    // plane local columns [first last), stops early if f returns true
+    template <typename Func>
+    bool for_each_masked_word(int row, int first, int last, Func && f) const;
+
+    // clips a region (in map positions) to plane local coordinates
+    bool clip(const sf::IntRect & region, sf::IntRect & local) const;
+
+    std::size_t word_index(int local_x, int local_y) const {
+        return std::size_t(local_y*m_words_per_row + local_x / k_word_bits);
+    }
+
+    sf::IntRect m_bounds;
+    int m_words_per_row = 0;
+    std::vector<Word> m_words;
+};
+
+/** Every bit plane of one tile layer, one per registered flag and in the
+ *  same order as the flags were registered. Planes may also keep a
+ *  TileCountTable, for rectangle counts in O(log n) time.
+ */
+class TileFlagPlanes {
+public:
+    using GidFlagsPtr = std::shared_ptr<const GidFlags>;
+
+    static TileFlag make_flag(std::size_t index)
+        { return TileFlag(int(index)); }
+
+    /** @returns index of a valid flag, in registration order */
+    static std::size_t index_of(TileFlag flag)
+        { return std::size_t(flag.m_id); }
+
+    /** Adds a plane for the next flag, built from the matrix's current
+     *  contents.
+     *  @param with_counts if true a count table is kept for the plane
+     */
+    void add_plane(GidFlagsPtr, const TileMatrix &, bool with_counts);
+
+    /** Starts keeping a count table for the given flag's plane, does nothing
+     *  if it already has one.
+     */
+    void enable_counts(TileFlag);
+
+    /** Brings all planes up to date after a single tile has changed. If the
+     *  matrix's bounds changed (this happens to infinite layers) then all
+     *  planes are rebuilt.
+     */
+    void update(const TileMatrix &, int x, int y, int new_gid);
+
+    /** Brings all planes up to date after many tiles have changed (the
+     *  matrix already holds the new gids). Count tables are rebuilt once
+     *  rather than updated per tile, if that is cheaper.
+     */
+    void update(const TileMatrix &, const std::vector<TileChange> &);
+
+    /** @returns plane for the given flag, nullptr if there is none */
+    const TileBitPlane * find_plane(TileFlag) const;
+
+    /** @returns count table for the given flag, nullptr if there is none */
+    const TileCountTable * find_counts(TileFlag) const;
+
+private:
+    struct Entry {
+        GidFlagsPtr gid_flags;
+        TileBitPlane plane;
+        std::unique_ptr<TileCountTable> counts;
+    };
+
+    Entry * find_entry(TileFlag);
+
+    // true if there is nothing left to update, either there are no planes
+    // or they were rebuilt (because the matrix's bounds changed)
+    bool rebuild_if_resized(const TileMatrix &);
+
+    std::vector<Entry> m_entries;
+};
+
+} // end of tmap namespace
@@ -27,29 +27,29 @@
 #include "TileLayer.hpp"
 #include <tmap/Base64.hpp>
 #include <tmap/ZLib.hpp>
+#include <tmap/ZStd.hpp>
 #include "TileSet.hpp"
+#include "Parallel.hpp"
 
 #include <SFML/Graphics/View.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
 
 #include <common/ConstString.hpp>
-#include <common/StringUtil.hpp>
 
 #include <tinyxml2.h>
 
 #include <stdexcept>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
+#include <array>
+#include <cstring>
 #include <locale>
 #include <cstdint>
 #include <cmath>
 #include <cassert>
 
-namespace tmap {
-
-struct TileCellExposer { using TileCell = TileLayer::TileCell; };
-
-}
-
 namespace {
 
 using Error           = std::runtime_error              ;
@@ -57,31 +57,102 @@ using Int32           = std::int32_t                    ;
 using TileSet         = tmap::TileSet                   ;
 using ConstTileSetPtr = tmap::TileLayer::ConstTileSetPtr;
 using TiXmlElement    = tmap::TiXmlElement              ;
-using TileCell        = tmap::TileCellExposer::TileCell ;
 using XmlRange        = tmap::XmlRange                  ;
+using TileMatrix      = tmap::TileMatrix                ;
+using GidVector       = std::vector<int>                ;
 
-/** Cleans out non-ascii and whitespace characters in the given string.
- *  @param str Target string to clean.
+/** Reads base64 tile data (which may be compressed) straight from the XML
+ *  text, a number of gids at a time. Only a small window of decoded data is
+ *  held at once, everything else goes directly to the caller's gids.
+ */
+class Base64TileReader {
+public:
+    enum Compression {
+        k_uncompressed,
+        k_zlib, // also gzip, which the inflater tells apart by header
+        k_zstd
+    };
+
+    Base64TileReader(const char * text, Compression);
+
+    /** Reads exactly count gids, throws if the tile data runs out first. */
+    void read(int * gids, std::size_t count);
+
+    /** Throws if there is more tile data than was read. */
+    void finish();
+
+private:
+    template <typename Stream>
+    void read_compressed(Stream &, Base64::UInt8 * out, std::size_t out_size);
+
+    template <typename Stream>
+    void finish_compressed(Stream &);
+
+    void refill_window_if_empty();
+
+    const char * m_text;
+    const char * m_text_end;
+    Base64::Decoder m_decoder;
+    // at most one, for compressed tile data
+    std::unique_ptr<ZLib::Inflater> m_inflater;
+    std::unique_ptr<ZStd::Decompressor> m_zstd_decompressor;
+    std::array<Base64::UInt8, 4096> m_window;
+    std::size_t m_window_begin = 0;
+    std::size_t m_window_end   = 0;
+};
+
+/** Loads the gids of either a layer's data element, or one of its chunks,
+ *  writing them into a matrix.
+ *  @param data_el    the layer's data element, which specifies the encoding
+ *  @param content_el the element whose text (or children) are the tiles, for
+ *                    finite maps this is the data element itself
+ *  @param area       where in the matrix the tiles go
+ *  @param max_threads most threads CSV text may be parsed with
  */
-void clean_string(std::string & str);
+void load_tile_data
+    (const TiXmlElement * data_el, const TiXmlElement * content_el,
+     TileMatrix & matrix, const sf::IntRect & area, const char * name,
+     std::size_t max_threads);
 
 void load_tile_data_base64
-    (const TiXmlElement * data_el, std::vector<TileCell> & loaded_tile_matrix,
-     const char * data_text, int width, int height);
+    (const TiXmlElement * data_el, const char * data_text,
+     TileMatrix & matrix, const sf::IntRect & area);
 
+/** Loads comma separated tile data, very large layers are split at line
+ *  breaks and parsed in parallel, on no more than max_threads threads.
+ */
 void load_tile_data_csv
-    (std::vector<TileCell> & loaded_tile_matrix,
-     const char * data_text, int width, int height);
+    (GidVector & loaded_gids, const char * data_text, int width, int height,
+     std::size_t max_threads);
+
+/** @returns number of integers in [beg end) */
+std::size_t count_csv_integers(const char * beg, const char * end);
+
+/** Parses comma separated integers (with any whitespace around them), as
+ *  unsigned 32 bit integers like Tiled writes, from [beg end) into
+ *  [out out_end).
+ *  @throws if the text isn't comma separated integers, or there's no room
+ *  @returns end of the integers written
+ */
+int * parse_csv_integers
+    (const char * beg, const char * end, int * out, int * out_end);
 
 void load_tile_data_xml
-    (const TiXmlElement * data_el, std::vector<TileCell> & loaded_tile_matrix,
+    (const TiXmlElement * data_el, GidVector & loaded_gids,
      const char * name, int width, int height);
 
+/** Loads all chunks of an infinite map's layer, empty chunks are not kept. */
+std::unique_ptr<TileMatrix> load_chunked_tile_data
+    (const TiXmlElement * data_el, const char * name, const sf::IntRect & bounds,
+     std::pmr::memory_resource * resource, std::size_t max_threads);
+
 } // end of <anonymous> namespace
 
 namespace tmap {
 
-TileLayer::TileLayer() {}
+TileLayer::TileLayer():
+    m_tile_matrix(std::make_unique<DenseTileMatrix>())
+{}
 
 void TileLayer::set_translation(float x, float y)
     { m_translation = sf::Vector2f(x, y); }
@@ -89,30 +160,264 @@ void TileLayer::set_translation(float x, float y)
 const TileLayer::PropertyMap * TileLayer::operator ()
     (int x, int y) const /* override */
 {
-    const TileCell & tcell = tile(x, y);
-    if (!tcell.tset) return nullptr;
-    return tcell.tset->properties_on_gid(tcell.gid);
+    const int gid = m_tile_matrix->gid_at(x, y);
+    const TileSet * tset = m_tilesets.find_tileset_for_gid(gid);
+    if (!tset) return nullptr;
+    return tset->properties_on_gid(gid);
+}
+
+const std::string * TileLayer::find_property
+    (int x, int y, PropertyKey key) const /* override */
+{
+    const int gid = m_tile_matrix->gid_at(x, y);
+    const TileSet * tset = m_tilesets.find_tileset_for_gid(gid);
+    if (!tset) return nullptr;
+    return tset->find_property(gid - tset->begin_gid(), key);
+}
+
+PropertyKey TileLayer::tile_type(int x, int y) const /* override */ {
+    const int gid = m_tile_matrix->gid_at(x, y);
+    const TileSet * tset = m_tilesets.find_tileset_for_gid(gid);
+    if (!tset) return PropertyKey();
+    return tset->type_key_of(gid - tset->begin_gid());
 }
 
 void TileLayer::set_tile_gid(int x, int y, int new_gid) {
-    auto tset = m_tilesets.find_tileset_for_gid(new_gid);
-    if (!tset) {
+    if (new_gid != k_no_tile && !m_tilesets.find_tileset_for_gid(new_gid)) {
         throw Error("TileLayer::set_tile_gid: gid \"" + std::to_string(new_gid) +
                     "\" does not have a tileset associated with it. The map "
                     "file's text should specify which gid's map to which "
                     "tilesets.");
     }
-    tile(x, y).gid  = new_gid;
-    tile(x, y).tset = tset   ;
+    const int old_gid = m_tile_matrix->gid_at(x, y);
+    m_tile_matrix->set_gid(x, y, new_gid);
+    m_flag_planes.update(*m_tile_matrix, x, y, new_gid);
+    if (m_position_index)
+        m_position_index->move(x, y, old_gid, new_gid);
+}
+
+void TileLayer::enable_position_index() /* override */ {
+    if (m_position_index) return;
+    m_position_index = std::make_unique<TilePositionIndex>(*m_tile_matrix);
+}
+
+void TileLayer::find_tiles_with_gid
+    (int gid, std::vector<TilePosition> & out) const /* override */
+{
+    if (gid == k_no_tile) return;
+    if (m_position_index) {
+        m_position_index->append_positions(gid, out);
+        return;
+    }
+    find_tiles_if([gid](int other) { return other == gid; }, out);
+}
+
+void TileLayer::find_tiles_with_property
+    (PropertyKey key, std::vector<TilePosition> & out) const /* override */
+{
+    if (!key.is_valid()) return;
+    find_tiles_if([this, key](int gid) {
+        const TileSet * tset = m_tilesets.find_tileset_for_gid(gid);
+        return tset && tset->find_property(gid - tset->begin_gid(), key);
+    }, out);
+}
+
+void TileLayer::find_tiles_of_type
+    (PropertyKey type, std::vector<TilePosition> & out) const /* override */
+{
+    if (!type.is_valid()) return;
+    find_tiles_if([this, type](int gid) {
+        const TileSet * tset = m_tilesets.find_tileset_for_gid(gid);
+        return tset && tset->type_key_of(gid - tset->begin_gid()) == type;
+    }, out);
+}
+
+bool TileLayer::test_flag(TileFlag flag, int x, int y) const /* override */ {
+    const auto * plane = m_flag_planes.find_plane(flag);
+    return plane ? plane->test(x, y) : false;
+}
+
+std::uint64_t TileLayer::flag_span
+    (TileFlag flag, int x, int y, int length) const /* override */
+{
+    const auto * plane = m_flag_planes.find_plane(flag);
+    return plane ? plane->span(x, y, length) : 0;
+}
+
+bool TileLayer::any_flag_in
+    (TileFlag flag, int x, int y, int width, int height) const /* override */
+{
+    const sf::IntRect region(x, y, width, height);
+    if (const auto * counts = m_flag_planes.find_counts(flag))
+        return counts->count(region) != 0;
+    const auto * plane = m_flag_planes.find_plane(flag);
+    return plane ? plane->any(region) : false;
 }
 
-int TileLayer::tile_gid(int x, int y) const { return tile(x, y).gid; }
+int TileLayer::count_flag_in
+    (TileFlag flag, int x, int y, int width, int height) const /* override */
+{
+    const sf::IntRect region(x, y, width, height);
+    if (const auto * counts = m_flag_planes.find_counts(flag))
+        return counts->count(region);
+    const auto * plane = m_flag_planes.find_plane(flag);
+    return plane ? plane->count(region) : 0;
+}
+
+int TileLayer::tile_gid(int x, int y) const
+    { return m_tile_matrix->gid_at(x, y); }
+
+void TileLayer::read_gids(int x, int y, int length, int * out) const /* override */ {
+    // only the part of the run inside the layer is read from the matrix
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    const int first = std::max(x, bounds.left);
+    const int last  = std::min(x + length, bounds.left + bounds.width);
+    if (y < bounds.top || y >= bounds.top + bounds.height || first >= last) {
+        std::fill(out, out + std::max(0, length), k_no_tile);
+        return;
+    }
+    std::fill(out, out + (first - x), k_no_tile);
+    m_tile_matrix->read_row(first, y, last - first, out + (first - x));
+    std::fill(out + (last - x), out + length, k_no_tile);
+}
+
+void TileLayer::write_gids(int x, int y, int length, const int * gids) /* override */ {
+    if (length > 0) check_region(sf::IntRect(x, y, length, 1), "write_gids");
+    write_region(x, y, length, 1, gids);
+}
+
+void TileLayer::read_region
+    (int x, int y, int width, int height, int * out) const /* override */
+{
+    const sf::IntRect region(x, y, width, height);
+    sf::IntRect inside;
+    if (region.intersects(m_tile_matrix->bounds(), inside) && inside == region) {
+        // matrices may have a better order to visit cells in than by row
+        m_tile_matrix->read_region(region, out);
+        return;
+    }
+    for (int row = y; row < y + height; ++row) {
+        read_gids(x, row, width, out);
+        out += width;
+    }
+}
+
+void TileLayer::write_region
+    (int x, int y, int width, int height, const int * gids) /* override */
+{
+    if (width <= 0 || height <= 0) return;
+    check_region(sf::IntRect(x, y, width, height), "write_region");
+    const std::size_t area = std::size_t(width)*std::size_t(height);
+    check_gids(gids, gids + area, "write_region");
+    std::vector<int> old_gids(area);
+    read_region(x, y, width, height, old_gids.data());
+    std::vector<TileChange> changes;
+    for (std::size_t i = 0; i != area; ++i) {
+        if (old_gids[i] == gids[i]) continue;
+        TileChange change;
+        change.x = x + int(i % std::size_t(width));
+        change.y = y + int(i / std::size_t(width));
+        change.old_gid = old_gids[i];
+        change.new_gid = gids[i];
+        changes.push_back(change);
+    }
+    apply_changes(changes);
+}
+
+void TileLayer::fill_region
+    (int x, int y, int width, int height, int gid) /* override */
+{
+    if (width <= 0 || height <= 0) return;
+    check_region(sf::IntRect(x, y, width, height), "fill_region");
+    check_gids(&gid, &gid + 1, "fill_region");
+    const std::size_t area = std::size_t(width)*std::size_t(height);
+    std::vector<int> old_gids(area);
+    read_region(x, y, width, height, old_gids.data());
+    std::vector<TileChange> changes;
+    for (std::size_t i = 0; i != area; ++i) {
+        if (old_gids[i] == gid) continue;
+        TileChange change;
+        change.x = x + int(i % std::size_t(width));
+        change.y = y + int(i / std::size_t(width));
+        change.old_gid = old_gids[i];
+        change.new_gid = gid;
+        changes.push_back(change);
+    }
+    apply_changes(changes);
+}
+
+int TileLayer::flood_replace(int x, int y, int new_gid) /* override */ {
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    if (!bounds.contains(x, y)) return 0;
+    const int old_gid = m_tile_matrix->gid_at(x, y);
+    if (old_gid == new_gid) return 0;
+    check_gids(&new_gid, &new_gid + 1, "flood_replace");
+
+    // filled a span of a row at a time, rows are read as the fill reaches
+    // them and filled cells are marked in them, so only rows the fill
+    // touches (and their neighbors) are ever held
+    std::unordered_map<int, std::vector<int>> rows;
+    auto row_at = [this, &rows, &bounds](int ly) -> std::vector<int> & {
+        auto itr = rows.find(ly);
+        if (itr == rows.end()) {
+            itr = rows.emplace(ly, std::vector<int>(std::size_t(bounds.width))).first;
+            m_tile_matrix->read_row(bounds.left, bounds.top + ly, bounds.width,
+                                    itr->second.data());
+        }
+        return itr->second;
+    };
+
+    std::vector<TileChange> changes;
+    std::vector<TilePosition> seeds;
+    seeds.push_back(TilePosition { x - bounds.left, y - bounds.top });
+    while (!seeds.empty()) {
+        const TilePosition seed = seeds.back();
+        seeds.pop_back();
+        std::vector<int> & row = row_at(seed.y);
+        if (row[std::size_t(seed.x)] != old_gid) continue;
+        int first = seed.x, last = seed.x + 1;
+        while (first > 0 && row[std::size_t(first - 1)] == old_gid) --first;
+        while (last < bounds.width && row[std::size_t(last)] == old_gid) ++last;
+        for (int lx = first; lx != last; ++lx) {
+            row[std::size_t(lx)] = new_gid;
+            TileChange change;
+            change.x = bounds.left + lx;
+            change.y = bounds.top  + seed.y;
+            change.old_gid = old_gid;
+            change.new_gid = new_gid;
+            changes.push_back(change);
+        }
+        // one seed per run of matching cells, in the rows above and below
+        for (int ly : { seed.y - 1, seed.y + 1 }) {
+            if (ly < 0 || ly >= bounds.height) continue;
+            const std::vector<int> & near_row = row_at(ly);
+            for (int lx = first; lx != last; ++lx) {
+                if (near_row[std::size_t(lx)] != old_gid) continue;
+                if (lx == first || near_row[std::size_t(lx - 1)] != old_gid)
+                    seeds.push_back(TilePosition { lx, ly });
+            }
+        }
+    }
+    apply_changes(changes);
+    return int(changes.size());
+}
+
+const TileSetInterface * TileLayer::tileset_of(int gid) const /* override */
+    { return m_tilesets.find_tileset_for_gid(gid); }
+
+TileLayer::TilePosition TileLayer::origin() const /* override */ {
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    TilePosition pos;
+    pos.x = bounds.left;
+    pos.y = bounds.top;
+    return pos;
+}
 
 int TileLayer::width() const /* override */
-    { return m_tile_matrix.width(); }
+    { return m_tile_matrix->bounds().width; }
 
 int TileLayer::height() const /* override */
-    { return m_tile_matrix.height(); }
+    { return m_tile_matrix->bounds().height; }
 
 /* static */ sf::IntRect TileLayer::compute_draw_range
     (const sf::View & view, const sf::Vector2f & tilesize,
@@ -138,8 +443,8 @@ int TileLayer::height() const /* override */
 
     // compute draw offset, that is how much we need to "back up" tiles before
     // what we see makes sense
-    sf::Vector2f offset(magnitude(std::remainder(fx, tilesize.x)),
-                        magnitude(std::remainder(fy, tilesize.y)));
+    sf::Vector2f offset(std::abs(std::remainder(fx, tilesize.x)),
+                        std::abs(std::remainder(fy, tilesize.y)));
 
     // next is size of selection, make sure the entire screen is filled
     draw_range.width  = int(std::ceil((field_size.x + offset.x) / tilesize.x));
@@ -179,38 +484,43 @@ int TileLayer::height() const /* override */
     DrawOnlyTarget restricted_target(&target);
 
     const sf::IntRect drange = compute_draw_range(target.getView());
+    // drawing reads a row at a time, and usually sees the same tileset many
+    // times in a row
+    std::vector<int> row_gids(std::size_t(std::max(0, drange.width)));
+    const TileSet * tset = nullptr;
     for (int y = drange.top ; y != drange.height + drange.top ; ++y) {
+    m_tile_matrix->read_row(drange.left, y, drange.width, row_gids.data());
     for (int x = drange.left; x != drange.width  + drange.left; ++x) {
-        const TileCell & tcell = tile(x, y);
-        if (!tcell.tset) continue;
+        const int gid = row_gids[std::size_t(x - drange.left)];
+        if (gid == k_no_tile) continue;
+        if (!tset || gid < tset->begin_gid() || gid >= tset->end_gid())
+            tset = m_tilesets.find_tileset_for_gid(gid);
+        if (!tset) continue;
         sf::Vector2f loc(x*m_tile_size.x, y*m_tile_size.y);
         loc += m_translation;
         loc.x = std::floor(loc.x);
         loc.y = std::floor(loc.y);
         sprite_brush.setPosition(loc);
         sprite_brush.setColor(sf::Color(255, 255, 255, sf::Uint8(m_opacity)));
-        sprite_brush.setTexture(tcell.tset->texture());
+        sprite_brush.setTexture(tset->texture());
 
-        auto frame = (*tcell.tset->tile_effect_for(tcell.gid))();
+        auto frame = (*tset->tile_effect_for(gid))();
         sf::IntRect txt_rect;
         if (frame == TileFrame())
-            txt_rect = tcell.tset->compute_texture_rect(tcell.gid);
+            txt_rect = tset->compute_texture_rect(gid);
         else
-            txt_rect = tcell.tset->compute_texture_rect(frame);
+            txt_rect = tset->compute_texture_rect(frame);
 
         sprite_brush.setTextureRect(txt_rect);
-        (*tcell.tset->tile_effect_for(tcell.gid))(sprite_brush, restricted_target);
+        (*tset->tile_effect_for(gid))(sprite_brush, restricted_target);
         sprite_brush = sf::Sprite();
     }}
 }
 
-TileLayer::TileCell & TileLayer::tile(int x, int y)
-    { return m_tile_matrix(x, y); }
-
-const TileLayer::TileCell & TileLayer::tile(int x, int y) const
-    { return m_tile_matrix(x, y); }
-
-/* private */ bool TileLayer::load_from_xml(const TiXmlElement * el) {
+/* private */ bool TileLayer::load_from_xml
+    (const TiXmlElement * el, const MapLoadOptions & options,
+     std::pmr::memory_resource * resource, std::size_t max_threads)
+{
     int width = read_int_attribute(el, "width");
     int height = read_int_attribute(el, "height");
     static constexpr const int k_max_color_value = 255;
@@ -228,48 +538,119 @@ const TileLayer::TileCell & TileLayer::tile(int x, int y) const
 
     // now to read the tile matrix
     // the means of which are determined by its encoding and compression
-
-    ConstString encoding;
-    {
-    const char * enc_cstr = data_el->Attribute("encoding");
-    encoding = (enc_cstr ? enc_cstr : "");
+    std::unique_ptr<TileMatrix> temp;
+    if (data_el->FirstChildElement("chunk")) {
+        // infinite maps' layers have no fixed size, only a starting area
+        sf::IntRect bounds(0, 0, width, height);
+        el->QueryIntAttribute("startx", &bounds.left);
+        el->QueryIntAttribute("starty", &bounds.top );
+        temp = load_chunked_tile_data(data_el, name, bounds, resource,
+                                      max_threads);
+    } else {
+        auto storage = options.tile_layer_storage;
+        auto sitr = options.tile_layer_storage_by_name.find(name ? name : "");
+        if (sitr != options.tile_layer_storage_by_name.end())
+            storage = sitr->second;
+        temp = make_tile_matrix(storage, width, height, resource,
+                                options.promote_hot_layers,
+                                options.promote_drawn_layers);
+        load_tile_data(data_el, data_el, *temp, sf::IntRect(0, 0, width, height),
+                       name, max_threads);
     }
-    const char * data_text = data_el->GetText();
-    std::vector<TileCell> loaded_tile_matrix;
 
-    loaded_tile_matrix.reserve(std::size_t(width*height));
+    if (name) m_name = name;
+    m_opacity = opacity;
+    m_tile_matrix.swap(temp);
+    return true;
+}
 
-    if (encoding == "base64" && data_text) {
-        load_tile_data_base64
-            (data_el, loaded_tile_matrix, data_text, width, height);
-    } else if (encoding == "csv") {
-        load_tile_data_csv(loaded_tile_matrix, data_text, width, height);
-    } else if (encoding == "") {
-        load_tile_data_xml(data_el, loaded_tile_matrix, name, width, height);
-    } else {
-        throw Error("tmap only knows how to handle base64 encoded, ZLib "
-                    "compressed tile data, please change file to use this "
-                    "format.");
+/* private */ void TileLayer::check_gids
+    (const int * beg, const int * end, const char * caller) const
+{
+    int last_checked = k_no_tile;
+    std::unordered_set<int> checked;
+    for (const int * itr = beg; itr != end; ++itr) {
+        const int gid = *itr;
+        if (gid == k_no_tile || gid == last_checked) continue;
+        last_checked = gid;
+        if (!checked.insert(gid).second) continue;
+        if (m_tilesets.find_tileset_for_gid(gid)) continue;
+        throw Error(std::string("TileLayer::") + caller + ": gid \"" +
+                    std::to_string(gid) + "\" does not have a tileset "
+                    "associated with it.");
     }
+}
 
-    for (TileCell & tcell : loaded_tile_matrix)
-        tcell.tset = m_tilesets.find_tileset_for_gid(tcell.gid);
-
-    Grid<TileCell> temp;
-    temp.set_size(width, height);
-    auto titr = loaded_tile_matrix.begin();
+/* private */ void TileLayer::check_region
+    (const sf::IntRect & region, const char * caller) const
+{
+    if (!m_tile_matrix->has_fixed_bounds()) return;
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    // compared as long long, so that no edge overflows
+    using Wide = long long;
+    if (region.left >= bounds.left && region.top >= bounds.top &&
+        Wide(region.left) + region.width  <= Wide(bounds.left) + bounds.width &&
+        Wide(region.top ) + region.height <= Wide(bounds.top ) + bounds.height)
+    { return; }
+    throw std::out_of_range(std::string("TileLayer::") + caller + ": region ("
+        + std::to_string(region.left) + ", " + std::to_string(region.top)
+        + ", " + std::to_string(region.width) + "x"
+        + std::to_string(region.height) + ") is not inside of the layer ("
+        + std::to_string(bounds.width) + "x" + std::to_string(bounds.height)
+        + ").");
+}
 
-    // it's old and needs to be update (should be on desktop somewhere)
-    for (auto & tc : temp) { tc = *titr++; }
+/* private */ void TileLayer::apply_changes(const std::vector<TileChange> & changes) {
+    if (changes.empty()) return;
+    for (const TileChange & change : changes)
+        m_tile_matrix->set_gid(change.x, change.y, change.new_gid);
+    m_flag_planes.update(*m_tile_matrix, changes);
+    if (m_position_index)
+        m_position_index->move(changes);
+}
 
-    if (name) m_name = name;
-    m_opacity = opacity;
-    temp.swap(m_tile_matrix);
-    return true;
+/* private */ template <typename Func>
+    void TileLayer::find_tiles_if
+    (Func && gid_pred, std::vector<TilePosition> & out) const
+{
+    if (m_position_index) {
+        m_position_index->append_positions_if(std::forward<Func>(gid_pred), out);
+        return;
+    }
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    std::vector<int> row_gids(std::size_t(bounds.width));
+    // runs of the same gid are common, so the last answer is kept
+    int last_gid = k_no_tile;
+    bool last_matched = false;
+    for (int y = bounds.top; y != bounds.top + bounds.height; ++y) {
+        m_tile_matrix->read_row(bounds.left, y, bounds.width, row_gids.data());
+        for (int i = 0; i != bounds.width; ++i) {
+            const int gid = row_gids[std::size_t(i)];
+            if (gid == k_no_tile) continue;
+            if (gid != last_gid) {
+                last_gid     = gid;
+                last_matched = gid_pred(gid);
+            }
+            if (!last_matched) continue;
+            TilePosition pos;
+            pos.x = bounds.left + i;
+            pos.y = y;
+            out.push_back(pos);
+        }
+    }
 }
 
 /* private */ sf::IntRect TileLayer::compute_draw_range(const sf::View & view) const {
-    return compute_draw_range(view, m_tile_size, width(), height());
+    // the static version only knows about grids starting at the origin
+    const sf::IntRect bounds = m_tile_matrix->bounds();
+    const sf::Vector2f offset(float(bounds.left)*m_tile_size.x,
+                              float(bounds.top )*m_tile_size.y);
+    sf::View shifted_view(view.getCenter() - offset, view.getSize());
+    sf::IntRect rv = compute_draw_range
+        (shifted_view, m_tile_size, bounds.width, bounds.height);
+    rv.left += bounds.left;
+    rv.top  += bounds.top ;
+    return rv;
 }
 
 // <--------------------- TileLayer::TileSetContainer ------------------------>
@@ -286,7 +667,7 @@ void TileLayer::TileSetContainer::sort() {
     m_is_sorted = true;
 }
 
-TileLayer::ConstTileSetPtr TileLayer::TileSetContainer::find_tileset_for_gid
+const TileSet * TileLayer::TileSetContainer::find_tileset_for_gid
     (int gid) const
 {
     // container must be sorted for binary search to work
@@ -294,96 +675,189 @@ TileLayer::ConstTileSetPtr TileLayer::TileSetContainer::find_tileset_for_gid
 
     if (gid == 0) return nullptr;
 
-    // NTS: why are we implementing this by hand?
-    auto beg = m_tilesets.begin();
-    auto end = m_tilesets.end();
-
-    while (beg != end) {
-        auto itr = beg + ((end - beg)/2);
-        ConstTileSetPtr cur = *itr;
-        if (gid < cur->begin_gid()) // go left
-            end = itr;
-        else if (gid >= cur->end_gid()) // go right
-            beg = itr;
-        else
-            return cur;
-    }
-    return nullptr;
+    // first tileset which ends after gid
+    auto itr = std::upper_bound(m_tilesets.begin(), m_tilesets.end(), gid,
+        [](int gid, const ConstTileSetPtr & tset)
+        { return gid < tset->end_gid(); });
+    if (itr == m_tilesets.end()) return nullptr;
+    if (gid < (**itr).begin_gid()) return nullptr;
+    return itr->get();
 }
 
 } // end of tmap namespace
 
 namespace {
 
-inline bool is_comma(char c) { return c == ','; }
-inline bool is_whitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\n'; }
+inline bool is_whitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+inline bool is_digit(char c) { return unsigned(c) - unsigned('0') < 10u; }
 
 // 1st level of helpers
 
-void clean_string(std::string & str) {
-    if (str.empty()) return;
-    const char k_erase_me = ' ' - 1;
-    for (char & e : str) {
-        if (e < ' ' || e > '~')
-            e = k_erase_me;
+void load_tile_data
+    (const TiXmlElement * data_el, const TiXmlElement * content_el,
+     TileMatrix & matrix, const sf::IntRect & area, const char * name,
+     std::size_t max_threads)
+{
+    ConstString encoding;
+    {
+    const char * enc_cstr = data_el->Attribute("encoding");
+    encoding = (enc_cstr ? enc_cstr : "");
+    }
+    const char * data_text = content_el->GetText();
+
+    if (encoding == "base64" && data_text) {
+        load_tile_data_base64(data_el, data_text, matrix, area);
+        return;
+    }
+    GidVector loaded_gids;
+    loaded_gids.reserve(std::size_t(area.width*area.height));
+    if (encoding == "csv") {
+        load_tile_data_csv(loaded_gids, data_text, area.width, area.height,
+                           max_threads);
+    } else if (encoding == "") {
+        load_tile_data_xml(content_el, loaded_gids, name, area.width, area.height);
+    } else {
+        throw Error("tmap only knows how to handle base64 encoded, ZLib "
+                    "compressed tile data, please change file to use this "
+                    "format.");
     }
-    str.erase(std::remove(str.begin(), str.end(), k_erase_me), str.end());
-    while (std::isblank(str.back())) str.pop_back();
-    auto itr = str.begin();
-    while (std::isblank(*itr)) ++itr;
-    str.erase(str.begin(), itr);
+    matrix.write_region(area, loaded_gids.data());
 }
 
 void load_tile_data_base64
-    (const TiXmlElement * data_el, std::vector<TileCell> & loaded_tile_matrix,
-     const char * data_text, int width, int height)
+    (const TiXmlElement * data_el, const char * data_text,
+     TileMatrix & matrix, const sf::IntRect & area)
 {
-    // decode raw data from string in XML
-    std::string filtered_data = data_text;
-    clean_string(filtered_data);
-    auto decoded_data = Base64::decode(filtered_data);
-
-    // it can be ZLib compressed, so check
-    const char * compression = data_el->Attribute("compression");
+    // it can be compressed, so check
+    auto compression_kind = Base64TileReader::k_uncompressed;
+    if (const char * compression = data_el->Attribute("compression")) {
+        const ConstString name = compression;
+        if (name == "zlib" || name == "gzip") {
+            compression_kind = Base64TileReader::k_zlib;
+        } else if (name == "zstd") {
+            compression_kind = Base64TileReader::k_zstd;
+        } else if (name != "") {
+            throw Error(std::string("Tile data is compressed with \"") +
+                        compression + "\", which tmap cannot decompress.");
+        }
+    }
+    Base64TileReader reader(data_text, compression_kind);
+
+    // one row at a time, so that the whole layer is never held twice, rows
+    // kept as plain gids are decoded straight into the matrix
+    GidVector row_gids;
+    for (int y = area.top; y != area.top + area.height; ++y) {
+        if (int * row = matrix.row_data(y)) {
+            reader.read(row + area.left, static_cast<std::size_t>(area.width));
+            continue;
+        }
+        row_gids.resize(static_cast<std::size_t>(area.width));
+        reader.read(row_gids.data(), row_gids.size());
+        matrix.write_region(sf::IntRect(area.left, y, area.width, 1), row_gids.data());
+    }
+    reader.finish();
+}
 
-    // decompress if necessary
-    if (compression && ConstString(compression) == "zlib")
-        decoded_data = ZLib::decompress(decoded_data);
+void load_tile_data_csv
+    (GidVector & loaded_gids, const char * data_text, int width, int height,
+     std::size_t max_threads)
+{
+    // large enough that starting a thread is worth it
+    static constexpr const std::size_t k_min_piece_size = std::size_t(1) << 20;
+
+    if (!data_text) data_text = "";
+    const char * text_end = data_text + std::strlen(data_text);
+    loaded_gids.resize(std::size_t(width)*std::size_t(height));
+    int * out     = loaded_gids.data();
+    int * out_end = out + loaded_gids.size();
+
+    const std::size_t text_size = std::size_t(text_end - data_text);
+    const std::size_t piece_count = std::min(text_size / k_min_piece_size, max_threads);
+    if (piece_count < 2) {
+        if (parse_csv_integers(data_text, text_end, out, out_end) != out_end)
+            throw Error("Number of tiles do not match size of tile sheet.");
+        return;
+    }
 
-    if (int(decoded_data.size()/sizeof(Int32)) != width*height) {
-        throw Error("Tile data does not provide information for all tiles "
-                    "in the layer.");
+    // every piece but the last ends just after a comma, so that no integer
+    // is split, and the pieces accept exactly what the whole text would
+    // (a piece may end in a comma, as the whole text may)
+    std::vector<const char *> piece_begins = { data_text };
+    for (std::size_t i = 1; i != piece_count; ++i) {
+        const char * begin = std::max(piece_begins.back(), data_text + (text_size*i) / piece_count);
+        begin = std::find(begin, text_end, ',');
+        if (begin == text_end) break;
+        piece_begins.push_back(begin + 1);
     }
+    piece_begins.push_back(text_end);
 
-    const Int32 * id_data = reinterpret_cast<const Int32 *>(decoded_data.data());
-    const Int32 * limit   = id_data + decoded_data.size()/sizeof(Int32);
+    // each piece's integers are counted, so pieces know where their
+    // integers go
+    std::vector<std::size_t> piece_offsets(piece_begins.size(), 0);
+    tmap::parallel_for(piece_begins.size() - 1, max_threads, [&](std::size_t i) {
+        piece_offsets[i + 1] = count_csv_integers(piece_begins[i], piece_begins[i + 1]);
+    });
+    for (std::size_t i = 1; i != piece_offsets.size(); ++i)
+        piece_offsets[i] += piece_offsets[i - 1];
+    if (piece_offsets.back() != loaded_gids.size())
+        throw Error("Number of tiles do not match size of tile sheet.");
 
-    for (int y = 0; y != height; ++y) {
-    for (int x = 0; x != width ; ++x) {
-        assert(limit != id_data); (void)limit;
-        loaded_tile_matrix.push_back(TileCell { *id_data++ });
-    }}
+    tmap::parallel_for(piece_begins.size() - 1, max_threads, [&](std::size_t i) {
+        int * const piece_end = out + piece_offsets[i + 1];
+        if (parse_csv_integers(piece_begins[i], piece_begins[i + 1],
+                               out + piece_offsets[i], piece_end) != piece_end)
+        { throw Error("Number of tiles do not match size of tile sheet."); }
+    });
 }
 
-void load_tile_data_csv
-    (std::vector<TileCell> & loaded_tile_matrix,
-     const char * data_text, int width, int height)
-{
-    for_split<is_comma>(data_text, data_text + strlen(data_text),
-        [&](const char * beg, const char * end)
-    {
-        trim<is_whitespace>(beg, end);
-        loaded_tile_matrix.emplace_back();
-        string_to_number(beg, end, loaded_tile_matrix.back().gid);
-    });
+std::size_t count_csv_integers(const char * beg, const char * end) {
+    if (beg == end) return 0;
+    // each integer starts where a digit follows a non digit
+    std::size_t count = is_digit(*beg) ? 1 : 0;
+    for (const char * itr = beg + 1; itr != end; ++itr)
+        count += std::size_t(is_digit(*itr) & !is_digit(*(itr - 1)));
+    return count;
+}
 
-    if (width*height != int(loaded_tile_matrix.size())) {
-        throw Error("Number of tiles do not match size of tile sheet.");
+int * parse_csv_integers
+    (const char * beg, const char * end, int * out, int * out_end)
+{
+    static constexpr const std::uint64_t k_max_value = UINT32_MAX;
+    const char * itr = beg;
+    while (true) {
+        while (itr != end && is_whitespace(*itr)) ++itr;
+        if (itr == end) break;
+
+        const char * digits_begin = itr;
+        std::uint64_t value = 0;
+        for (; itr != end && is_digit(*itr); ++itr) {
+            value = value*10 + std::uint64_t(*itr - '0');
+            if (value > k_max_value)
+                throw Error("Tile data contains a gid too large for 32 bits.");
+        }
+        if (itr == digits_begin) {
+            throw Error(std::string("Tile data contains \"") + *itr + "\", where "
+                        "only digits, commas and whitespace are expected.");
+        }
+        if (out == out_end)
+            throw Error("Number of tiles do not match size of tile sheet.");
+        // gids are unsigned, with flip flags in the upper bits
+        *out++ = int(std::uint32_t(value));
+
+        while (itr != end && is_whitespace(*itr)) ++itr;
+        if (itr == end) break;
+        if (*itr != ',') {
+            throw Error(std::string("Tile data contains \"") + *itr + "\", where "
+                        "only digits, commas and whitespace are expected.");
+        }
+        ++itr;
     }
+    return out;
 }
 
 void load_tile_data_xml
-    (const TiXmlElement * data_el, std::vector<TileCell> & loaded_tile_matrix,
+    (const TiXmlElement * data_el, GidVector & loaded_gids,
      const char * name, int width, int height)
 {
     if (!name)
@@ -401,7 +875,7 @@ void load_tile_data_xml
             // need to have "warnings"
             throw Error("Tile tag must specify a gid attribute.");
         }
-        loaded_tile_matrix.push_back(TileCell { gid });
+        loaded_gids.push_back(gid);
     }
     if (tile_counter != width*height) {
         throw Error(
@@ -413,4 +887,119 @@ void load_tile_data_xml
     }
 }
 
+std::unique_ptr<TileMatrix> load_chunked_tile_data
+    (const TiXmlElement * data_el, const char * name, const sf::IntRect & bounds,
+     std::pmr::memory_resource * resource, std::size_t max_threads)
+{
+    auto matrix = std::make_unique<tmap::ChunkedTileMatrix>(bounds, resource);
+    for (const TiXmlElement & chunk_el : XmlRange(data_el, "chunk")) {
+        const int chunk_x      = tmap::read_int_attribute(&chunk_el, "x"     );
+        const int chunk_y      = tmap::read_int_attribute(&chunk_el, "y"     );
+        const int chunk_width  = tmap::read_int_attribute(&chunk_el, "width" );
+        const int chunk_height = tmap::read_int_attribute(&chunk_el, "height");
+
+        load_tile_data(data_el, &chunk_el, *matrix,
+                       sf::IntRect(chunk_x, chunk_y, chunk_width, chunk_height),
+                       name, max_threads);
+    }
+    return matrix;
+}
+
+// Tiled writes gids as 32 bit little endian integers, which are read
+// straight into ints
+static_assert(sizeof(int) == sizeof(Int32), "ints must be 32 bits wide");
+
+const char * const k_missing_tiles_msg =
+    "Tile data does not provide information for all tiles in the layer.";
+
+const char * const k_extra_tiles_msg =
+    "Tile data holds more tiles than the layer's size.";
+
+// the two compressed stream kinds, fed the same way
+inline std::size_t feed_stream
+    (ZLib::Inflater & stream, const Base64::UInt8 * in, std::size_t in_size)
+{ return stream.inflate(in, in_size); }
+
+inline std::size_t feed_stream
+    (ZStd::Decompressor & stream, const Base64::UInt8 * in, std::size_t in_size)
+{ return stream.decompress(in, in_size); }
+
+Base64TileReader::Base64TileReader(const char * text, Compression compression):
+    m_text(text),
+    m_text_end(text + std::strlen(text))
+{
+    if (compression == k_zlib)
+        m_inflater = std::make_unique<ZLib::Inflater>();
+    else if (compression == k_zstd)
+        m_zstd_decompressor = std::make_unique<ZStd::Decompressor>();
+}
+
+void Base64TileReader::read(int * gids, std::size_t count) {
+    auto * out = reinterpret_cast<Base64::UInt8 *>(gids);
+    const std::size_t out_size = count*sizeof(int);
+    if (m_inflater) {
+        read_compressed(*m_inflater, out, out_size);
+    } else if (m_zstd_decompressor) {
+        read_compressed(*m_zstd_decompressor, out, out_size);
+    } else if (m_decoder.decode(m_text, m_text_end, out, out_size) != out_size) {
+        throw Error(k_missing_tiles_msg);
+    }
+}
+
+void Base64TileReader::finish() {
+    if (m_inflater) {
+        finish_compressed(*m_inflater);
+    } else if (m_zstd_decompressor) {
+        finish_compressed(*m_zstd_decompressor);
+    } else {
+        Base64::UInt8 extra;
+        if (m_decoder.decode(m_text, m_text_end, &extra, 1) != 0)
+            throw Error(k_extra_tiles_msg);
+        m_decoder.finish();
+    }
+}
+
+/* private */ template <typename Stream>
+    void Base64TileReader::read_compressed
+    (Stream & stream, Base64::UInt8 * out, std::size_t out_size)
+{
+    stream.set_output(out, out_size);
+    while (stream.output_remaining() != 0) {
+        if (stream.finished())
+            throw Error(k_missing_tiles_msg);
+        refill_window_if_empty();
+        const std::size_t remaining = stream.output_remaining();
+        const std::size_t consumed = feed_stream
+            (stream, m_window.data() + m_window_begin, m_window_end - m_window_begin);
+        m_window_begin += consumed;
+        // no progress, means no more text to decode
+        if (consumed == 0 && remaining == stream.output_remaining())
+            throw Error(k_missing_tiles_msg);
+    }
+}
+
+/* private */ template <typename Stream>
+    void Base64TileReader::finish_compressed(Stream & stream)
+{
+    // the stream must end exactly where the tiles do
+    Base64::UInt8 extra;
+    stream.set_output(&extra, 1);
+    while (!stream.finished()) {
+        refill_window_if_empty();
+        const std::size_t consumed = feed_stream
+            (stream, m_window.data() + m_window_begin, m_window_end - m_window_begin);
+        m_window_begin += consumed;
+        if (stream.output_remaining() == 0)
+            throw Error(k_extra_tiles_msg);
+        if (consumed == 0 && !stream.finished())
+            throw Error("Compressed tile data ends early.");
+    }
+}
+
+/* private */ void Base64TileReader::refill_window_if_empty() {
+    if (m_window_begin != m_window_end) return;
+    m_window_begin = 0;
+    m_window_end   = m_decoder.decode(m_text, m_text_end, m_window.data(), m_window.size());
+}
+
 } // end of <anonymous> namespace
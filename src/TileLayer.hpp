@@ -26,14 +26,17 @@
 
 #pragma once
 
-#include <common/Grid.hpp>
-
 #include <tmap/TilePropertiesInterface.hpp>
 
 #include "MapLayer.hpp"
 #include "TiXmlHelpers.hpp"
+#include "TileMatrix.hpp"
+#include "TileFlagPlanes.hpp"
+#include "TilePositionIndex.hpp"
 
 #include <memory>
+#include <memory_resource>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -42,11 +45,14 @@ namespace sf { class View; }
 namespace tmap {
 
 class TileSet;
-struct TileCellExposer;
 
 /** A TileLayer is a Tiled Layer of the map, which any part of it can be drawn
  *  at any location at any size. TileLayers can be loaded from an XML element
  *  specified in a TilEd map file.
+ *  @n
+ *  Layers of "infinite" maps are stored sparsely by chunk, any position may
+ *  be read from them (including negative ones), width and height are that of
+ *  the area containing all of the layer's tiles.
  *  @note Possible future feature: tile effects
  *  @warning A TileLayer is dependant on knowing constant addresses to tilesets
  *           so it is able to render tiles, see load_from_xml for more
@@ -54,8 +60,6 @@ struct TileCellExposer;
  */
 class TileLayer final : public MapLayer, public TilePropertiesInterface {
 public:
-    friend struct TileCellExposer;
-
     using ConstTileSetPtr = std::shared_ptr<const TileSet>;
     using TileSetPtr      = std::shared_ptr<TileSet>;
 
@@ -72,16 +76,26 @@ public:
      *  @param el XML element from TilEd in which TileLayer's information is
      *            defined.
      *  @param tilesets The complete and final set of tilesets for the map.
+     *  @param options  Memory layout to use (by layer name), ignored for
+     *                  infinite maps.
+     *  @param resource Where the tile matrix's cells are allocated from.
+     *  @param max_threads Most threads a very large layer may be parsed
+     *                     with, a loader already running layers on
+     *                     several threads should pass its share.
      *  @tparam Container should have elements that are constant TileSet STL
      *          shared pointer.
      *  @return Returns true if the xml was sucessfully loaded. (maybe removed)
      */
     template <typename Container>
-    bool load_from_xml(const TiXmlElement * el, const Container & tilesets) {
+    bool load_from_xml(const TiXmlElement * el, const Container & tilesets,
+                       const MapLoadOptions & options = MapLoadOptions(),
+                       std::pmr::memory_resource * resource = std::pmr::get_default_resource(),
+                       std::size_t max_threads = std::thread::hardware_concurrency())
+    {
         for (ConstTileSetPtr tileset : tilesets)
             m_tilesets.add_tileset(tileset);
         m_tilesets.sort();
-        return load_from_xml(el);
+        return load_from_xml(el, options, resource, max_threads);
     }
 
     /** A tile layer cannot know what tile size to use from the XML used to
@@ -101,12 +115,90 @@ public:
 
     const PropertyMap * operator () (int x, int y) const override;
 
+    /** @copydoc TilePropertiesInterface::find_property(int,int,PropertyKey) */
+    const std::string * find_property(int x, int y, PropertyKey key) const override;
+
+    /** @copydoc TilePropertiesInterface::tile_type(int,int) */
+    PropertyKey tile_type(int x, int y) const override;
+
+    /** @copydoc TilePropertiesInterface::test_flag(TileFlag,int,int) */
+    bool test_flag(TileFlag flag, int x, int y) const override;
+
+    /** @copydoc TilePropertiesInterface::flag_span(TileFlag,int,int,int) */
+    std::uint64_t flag_span(TileFlag flag, int x, int y, int length) const override;
+
+    /** @copydoc TilePropertiesInterface::any_flag_in(TileFlag,int,int,int,int) */
+    bool any_flag_in
+        (TileFlag flag, int x, int y, int width, int height) const override;
+
+    /** @copydoc TilePropertiesInterface::count_flag_in(TileFlag,int,int,int,int) */
+    int count_flag_in
+        (TileFlag flag, int x, int y, int width, int height) const override;
+
+    /** @copydoc TilePropertiesInterface::enable_position_index() */
+    void enable_position_index() override;
+
+    /** @copydoc TilePropertiesInterface::find_tiles_with_gid(int,std::vector<TilePosition>&) const */
+    void find_tiles_with_gid
+        (int gid, std::vector<TilePosition> & out) const override;
+
+    /** @copydoc TilePropertiesInterface::find_tiles_with_property(PropertyKey,std::vector<TilePosition>&) const */
+    void find_tiles_with_property
+        (PropertyKey key, std::vector<TilePosition> & out) const override;
+
+    /** @copydoc TilePropertiesInterface::find_tiles_of_type(PropertyKey,std::vector<TilePosition>&) const */
+    void find_tiles_of_type
+        (PropertyKey type, std::vector<TilePosition> & out) const override;
+
+    /** Adds a bit plane for the next registered flag, flags must be added in
+     *  the order they were registered.
+     *  @param with_counts if true a summed-area table is kept as well
+     */
+    void add_flag_plane(TileFlagPlanes::GidFlagsPtr gid_flags, bool with_counts) {
+        m_flag_planes.add_plane(std::move(gid_flags), *m_tile_matrix,
+                                with_counts);
+    }
+
+    /** Releases memory the tile matrix does not need for its current
+     *  contents.
+     */
+    void compact_storage() { m_tile_matrix->compact(); }
+
+    /** Keeps a summed-area table for an already added flag. */
+    void enable_flag_counts(TileFlag flag)
+        { m_flag_planes.enable_counts(flag); }
+
     /** @copydoc TilePropertiesInterface::set_tile_gid(int,int,int) */
     void set_tile_gid(int x, int y, int new_gid) override;
 
     /** @copydoc TilePropertiesInterface::tile_gid(int,int) */
     int tile_gid(int x, int y) const override;
 
+    /** @copydoc TilePropertiesInterface::read_gids(int,int,int,int*) const */
+    void read_gids(int x, int y, int length, int * out) const override;
+
+    /** @copydoc TilePropertiesInterface::write_gids(int,int,int,const int*) */
+    void write_gids(int x, int y, int length, const int * gids) override;
+
+    /** @copydoc TilePropertiesInterface::read_region(int,int,int,int,int*) const */
+    void read_region(int x, int y, int width, int height, int * out) const override;
+
+    /** @copydoc TilePropertiesInterface::write_region(int,int,int,int,const int*) */
+    void write_region
+        (int x, int y, int width, int height, const int * gids) override;
+
+    /** @copydoc TilePropertiesInterface::fill_region(int,int,int,int,int) */
+    void fill_region(int x, int y, int width, int height, int gid) override;
+
+    /** @copydoc TilePropertiesInterface::flood_replace(int,int,int) */
+    int flood_replace(int x, int y, int new_gid) override;
+
+    /** @copydoc TilePropertiesInterface::tileset_of(int) const */
+    const TileSetInterface * tileset_of(int gid) const override;
+
+    /** @copydoc TilePropertiesInterface::origin() const */
+    TilePosition origin() const override;
+
     /** @copydoc TilePropertiesInterface::width() */
     int width() const override;
 
@@ -162,35 +254,44 @@ private:
          *  @return Pointer to tileset associated with the gid, if there is no
          *          such tileset in the container, nullptr is returned.
          */
-        ConstTileSetPtr find_tileset_for_gid(int gid) const;
+        const TileSet * find_tileset_for_gid(int gid) const;
 
     private:
         bool m_is_sorted = false;
         std::vector<ConstTileSetPtr> m_tilesets;
     };
 
-    struct TileCell {
-        TileCell() {}
-        explicit TileCell(int gid_): gid(gid_) {}
-        int gid = 0;
-        ConstTileSetPtr tset = nullptr;
-    };
+    bool load_from_xml(const TiXmlElement * el, const MapLoadOptions & options,
+                       std::pmr::memory_resource * resource,
+                       std::size_t max_threads);
+
+    // throws if any gid in [beg end) has no tileset, each distinct gid is
+    // only looked up once
+    void check_gids(const int * beg, const int * end, const char * caller) const;
 
-    TileCell & tile(int x, int y);
+    // throws std::out_of_range if the region is not inside of the layer,
+    // which only finite layers have to be
+    void check_region(const sf::IntRect & region, const char * caller) const;
 
-    const TileCell & tile(int x, int y) const;
+    // writes new gids into the matrix, then brings flag planes and the
+    // position index up to date once for all of them
+    void apply_changes(const std::vector<TileChange> &);
 
-    bool load_from_xml(const TiXmlElement * el);
+    // the position index if there is one, otherwise scans the layer
+    template <typename Func>
+    void find_tiles_if(Func && gid_pred, std::vector<TilePosition> & out) const;
 
     sf::IntRect compute_draw_range(const sf::View &) const;
 
     std::string m_name;
-    Grid<TileCell> m_tile_matrix;
+    std::unique_ptr<TileMatrix> m_tile_matrix;
     sf::Vector2f m_tile_size;
     sf::Vector2f m_translation;
     int m_opacity = 1;
 
     TileSetContainer m_tilesets;
+    TileFlagPlanes m_flag_planes;
+    std::unique_ptr<TilePositionIndex> m_position_index;
 };
 
 } // end of tmap namespace
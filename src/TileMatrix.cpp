@@ -0,0 +1,546 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "TileMatrix.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <cassert>
+
+namespace tmap {
+
+/* vtable anchor */ TileMatrix::~TileMatrix() {}
+
+void TileMatrix::read_region(const sf::IntRect & region, int * out) const {
+    for (int y = region.top; y != region.top + region.height; ++y) {
+        read_row(region.left, y, region.width, out);
+        out += region.width;
+    }
+}
+
+void TileMatrix::write_region(const sf::IntRect & region, const int * gids) {
+    for (int y = region.top ; y != region.top  + region.height; ++y) {
+    for (int x = region.left; x != region.left + region.width ; ++x) {
+        set_gid(x, y, *gids++);
+    }}
+}
+
+// <---------------------------- DenseTileMatrix ----------------------------->
+
+DenseTileMatrix::DenseTileMatrix
+    (int width, int height, std::pmr::memory_resource * resource):
+    m_width(width),
+    m_height(height),
+    m_gids(std::size_t(width*height), 0, resource)
+{}
+
+void DenseTileMatrix::read_row(int x, int y, int length, int * out) const {
+    assert(x >= 0 && x + length <= m_width);
+    const int * row = m_gids.data() + index_of(x, y);
+    std::copy(row, row + length, out);
+}
+
+void DenseTileMatrix::write_region(const sf::IntRect & region, const int * gids) {
+    assert(region.left >= 0 && region.left + region.width  <= m_width );
+    assert(region.top  >= 0 && region.top  + region.height <= m_height);
+    for (int y = region.top; y != region.top + region.height; ++y) {
+        std::copy(gids, gids + region.width,
+                  m_gids.begin() + std::ptrdiff_t(index_of(region.left, y)));
+        gids += region.width;
+    }
+}
+
+sf::IntRect DenseTileMatrix::bounds() const
+    { return sf::IntRect(0, 0, m_width, m_height); }
+
+// <--------------------------- BlockedTileMatrix ---------------------------->
+
+/* static */ constexpr const int BlockedTileMatrix::k_block_size;
+/* static */ constexpr const int BlockedTileMatrix::k_block_shift;
+/* static */ constexpr const int BlockedTileMatrix::k_block_mask;
+/* static */ constexpr const int BlockedTileMatrix::k_block_area;
+
+BlockedTileMatrix::BlockedTileMatrix
+    (int width, int height, std::pmr::memory_resource * resource):
+    m_width(width),
+    m_height(height),
+    m_blocks_across((width + k_block_size - 1) / k_block_size),
+    m_gids(resource)
+{
+    const int blocks_down = (height + k_block_size - 1) / k_block_size;
+    m_gids.resize(std::size_t(m_blocks_across*blocks_down*k_block_area), 0);
+}
+
+void BlockedTileMatrix::read_row(int x, int y, int length, int * out) const {
+    assert(x >= 0 && x + length <= m_width);
+    // the row's half of each index is the same throughout
+    const std::size_t row_bits = spread_bits(y) << 1;
+    int * const out_end = out + length;
+    while (out != out_end) {
+        const std::size_t block_start = block_of(x, y)*k_block_area;
+        const int run = std::min(int(out_end - out), k_block_size - x % k_block_size);
+        for (int i = 0; i != run; ++i) {
+            *out++ = m_gids[block_start + row_bits + spread_bits(x + i)];
+        }
+        x += run;
+    }
+}
+
+void BlockedTileMatrix::read_region(const sf::IntRect & region, int * out) const {
+    assert(region.left >= 0 && region.left + region.width  <= m_width );
+    assert(region.top  >= 0 && region.top  + region.height <= m_height);
+    // visit a block at a time, so that each block is only brought in once
+    const int right  = region.left + region.width ;
+    const int bottom = region.top  + region.height;
+    for (int by = region.top; by < bottom; by += k_block_size - by % k_block_size) {
+    for (int bx = region.left; bx < right; bx += k_block_size - bx % k_block_size) {
+        const std::size_t block_start = block_of(bx, by)*k_block_area;
+        const int block_right  = std::min(right , bx + k_block_size - bx % k_block_size);
+        const int block_bottom = std::min(bottom, by + k_block_size - by % k_block_size);
+        for (int y = by; y != block_bottom; ++y) {
+            int * out_row = out + (y - region.top)*region.width;
+            for (int x = bx; x != block_right; ++x) {
+                out_row[x - region.left] =
+                    m_gids[block_start + index_in_block(x, y)];
+            }
+        }
+    }}
+}
+
+void BlockedTileMatrix::write_region(const sf::IntRect & region, const int * gids) {
+    assert(region.left >= 0 && region.left + region.width  <= m_width );
+    assert(region.top  >= 0 && region.top  + region.height <= m_height);
+    // like read_region, a block at a time
+    const int right  = region.left + region.width ;
+    const int bottom = region.top  + region.height;
+    for (int by = region.top; by < bottom; by += k_block_size - by % k_block_size) {
+    for (int bx = region.left; bx < right; bx += k_block_size - bx % k_block_size) {
+        const std::size_t block_start = block_of(bx, by)*k_block_area;
+        const int block_right  = std::min(right , bx + k_block_size - bx % k_block_size);
+        const int block_bottom = std::min(bottom, by + k_block_size - by % k_block_size);
+        for (int y = by; y != block_bottom; ++y) {
+            const int * gids_row = gids + (y - region.top)*region.width;
+            for (int x = bx; x != block_right; ++x) {
+                m_gids[block_start + index_in_block(x, y)] =
+                    gids_row[x - region.left];
+            }
+        }
+    }}
+}
+
+// <--------------------------- PaletteTileMatrix ---------------------------->
+
+/* static */ constexpr const int PaletteTileMatrix::k_word_bits;
+
+PaletteTileMatrix::PaletteTileMatrix
+    (int width, int height, std::pmr::memory_resource * resource):
+    m_width(width),
+    m_height(height),
+    m_words((std::size_t(width*height) + k_word_bits - 1) / k_word_bits, 0, resource),
+    m_palette(resource),
+    m_palette_indices(resource)
+{
+    // every cell starts out empty, which is index zero
+    m_palette.push_back(0);
+    m_palette_indices.emplace(0, 0);
+}
+
+void PaletteTileMatrix::set_gid(int x, int y, int gid) {
+    // checked before the palette is touched
+    const std::size_t cell = cell_of(x, y);
+    auto itr = m_palette_indices.find(gid);
+    if (itr == m_palette_indices.end()) {
+        const int needed_bits = bits_for(m_palette.size() + 1);
+        if (needed_bits != m_bits) {
+            std::pmr::vector<std::uint32_t> same_indices
+                (m_palette.size(), m_palette.get_allocator().resource());
+            for (std::size_t i = 0; i != same_indices.size(); ++i)
+                same_indices[i] = std::uint32_t(i);
+            repack(needed_bits, same_indices);
+        }
+        itr = m_palette_indices.emplace(gid, std::uint32_t(m_palette.size())).first;
+        m_palette.push_back(gid);
+    }
+    set_index_at(cell, itr->second);
+}
+
+void PaletteTileMatrix::read_row(int x, int y, int length, int * out) const {
+    assert(x >= 0 && x + length <= m_width);
+    std::size_t cell = std::size_t(y*m_width + x);
+    const int * const out_end = out + length;
+    const int per_word = k_word_bits / m_bits;
+    while (out != out_end) {
+        // unpack as many indices as are left in this word
+        const int offset = int(cell % std::size_t(per_word));
+        const int run = std::min(int(out_end - out), per_word - offset);
+        Word word = m_words[cell / std::size_t(per_word)] >> (offset*m_bits);
+        for (int i = 0; i != run; ++i) {
+            *out++ = m_palette[std::size_t(word & m_mask)];
+            word >>= m_bits;
+        }
+        cell += std::size_t(run);
+    }
+}
+
+void PaletteTileMatrix::compact() {
+    const std::size_t cell_count = std::size_t(m_width*m_height);
+    std::pmr::memory_resource * resource = m_palette.get_allocator().resource();
+    std::pmr::vector<bool> used(m_palette.size(), false, resource);
+    // empty stays at index zero regardless
+    used[0] = true;
+    for (std::size_t cell = 0; cell != cell_count; ++cell)
+        used[index_at(cell)] = true;
+
+    std::pmr::vector<std::uint32_t> old_to_new(m_palette.size(), resource);
+    // swapped in below, so it must share the palette's resource
+    std::pmr::vector<int> palette(resource);
+    for (std::size_t i = 0; i != m_palette.size(); ++i) {
+        if (!used[i]) continue;
+        old_to_new[i] = std::uint32_t(palette.size());
+        palette.push_back(m_palette[i]);
+    }
+    if (palette.size() == m_palette.size()) return;
+
+    repack(bits_for(palette.size()), old_to_new);
+    m_palette.swap(palette);
+    m_palette.shrink_to_fit();
+    m_palette_indices.clear();
+    for (std::size_t i = 0; i != m_palette.size(); ++i)
+        m_palette_indices.emplace(m_palette[i], std::uint32_t(i));
+}
+
+/* private static */ int PaletteTileMatrix::bits_for(std::size_t palette_size) {
+    for (int bits : { 1, 2, 4, 8, 16 }) {
+        if (palette_size <= (std::size_t(1) << bits)) return bits;
+    }
+    return 32;
+}
+
+/* private */ void PaletteTileMatrix::set_index_at(std::size_t cell, std::size_t index) {
+    const std::size_t bit = cell*std::size_t(m_bits);
+    assert(bit / k_word_bits < m_words.size());
+    Word & word = m_words[bit / k_word_bits];
+    const int shift = int(bit % k_word_bits);
+    word = (word & ~(m_mask << shift)) | (Word(index) << shift);
+}
+
+/* private */ void PaletteTileMatrix::repack
+    (int new_bits, const std::pmr::vector<std::uint32_t> & old_to_new)
+{
+    const std::size_t cell_count = std::size_t(m_width*m_height);
+    // words must come from the same resource for them to be swapped
+    PaletteTileMatrix packed(0, 0, m_words.get_allocator().resource());
+    packed.m_bits = new_bits;
+    packed.m_mask = (new_bits == 32) ? Word(0xFFFFFFFFu) : ((Word(1) << new_bits) - 1);
+    packed.m_words.resize
+        ((cell_count*std::size_t(new_bits) + k_word_bits - 1) / k_word_bits, 0);
+    for (std::size_t cell = 0; cell != cell_count; ++cell)
+        packed.set_index_at(cell, old_to_new[index_at(cell)]);
+    m_bits = new_bits;
+    m_mask = packed.m_mask;
+    m_words.swap(packed.m_words);
+}
+
+// <-------------------------- RunLengthTileMatrix --------------------------->
+
+/* static */ constexpr const int RunLengthTileMatrix::k_promote_after_writes;
+/* static */ constexpr const int RunLengthTileMatrix::k_promote_after_passes;
+
+RunLengthTileMatrix::RunLengthTileMatrix
+    (int width, int height, bool promote_when_written, bool promote_when_read,
+     std::pmr::memory_resource * resource):
+    m_width(width),
+    m_height(height),
+    m_promote_when_written(promote_when_written),
+    m_promote_when_read(promote_when_read),
+    m_rows(std::size_t(height), RunRow(1, Run(), resource), resource),
+    m_promoted(resource)
+{}
+
+int RunLengthTileMatrix::gid_at(int x, int y) const {
+    assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+    if (is_promoted()) return m_promoted[std::size_t(y*m_width + x)];
+    const RunRow & row = m_rows[std::size_t(y)];
+    return row[run_index(row, x)].gid;
+}
+
+void RunLengthTileMatrix::set_gid(int x, int y, int gid) {
+    assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+    if (!is_promoted() && m_promote_when_written &&
+        ++m_writes*k_promote_after_writes > long(m_width)*long(m_height))
+    { promote(); }
+    if (is_promoted()) {
+        m_promoted[std::size_t(y*m_width + x)] = gid;
+        return;
+    }
+    set_run_gid(x, y, gid);
+}
+
+void RunLengthTileMatrix::read_row(int x, int y, int length, int * out) const {
+    assert(x >= 0 && x + length <= m_width);
+    if (!is_promoted() && m_promote_when_read &&
+        ++m_rows_read > long(k_promote_after_passes)*long(m_height))
+    { promote(); }
+    if (is_promoted()) {
+        const int * row = m_promoted.data() + y*m_width + x;
+        std::copy(row, row + length, out);
+        return;
+    }
+    const RunRow & row = m_rows[std::size_t(y)];
+    int * const out_end = out + length;
+    for (std::size_t i = run_index(row, x); out != out_end; ++i) {
+        const int run_end = (i + 1 == row.size()) ? m_width : row[i + 1].x;
+        const int run = std::min(int(out_end - out), run_end - x);
+        std::fill(out, out + run, row[i].gid);
+        out += run;
+        x   += run;
+    }
+}
+
+void RunLengthTileMatrix::write_region(const sf::IntRect & region, const int * gids) {
+    if (is_promoted()) {
+        for (int y = region.top; y != region.top + region.height; ++y) {
+            std::copy(gids, gids + region.width,
+                      m_promoted.begin() + (y*m_width + region.left));
+            gids += region.width;
+        }
+        return;
+    }
+    for (int y = region.top; y != region.top + region.height; ++y) {
+        if (region.left == 0 && region.width == m_width) {
+            encode_row(y, gids);
+        } else {
+            for (int i = 0; i != region.width; ++i)
+                set_run_gid(region.left + i, y, gids[i]);
+        }
+        gids += region.width;
+    }
+}
+
+void RunLengthTileMatrix::compact() {
+    m_writes = m_rows_read = 0;
+    if (is_promoted()) {
+        for (int y = 0; y != m_height; ++y)
+            encode_row(y, m_promoted.data() + y*m_width);
+        m_promoted.clear();
+    }
+    m_promoted.shrink_to_fit();
+    for (RunRow & row : m_rows) row.shrink_to_fit();
+}
+
+std::size_t RunLengthTileMatrix::run_count() const {
+    std::size_t rv = 0;
+    for (const RunRow & row : m_rows) rv += row.size();
+    return rv;
+}
+
+/* private static */ std::size_t RunLengthTileMatrix::run_index
+    (const RunRow & row, int x)
+{
+    // the first run always starts at zero
+    auto itr = std::upper_bound(row.begin(), row.end(), x,
+        [](int x, const Run & run) { return x < run.x; });
+    assert(itr != row.begin());
+    return std::size_t((itr - row.begin()) - 1);
+}
+
+/* private */ void RunLengthTileMatrix::set_run_gid(int x, int y, int gid) {
+    RunRow & row = m_rows[std::size_t(y)];
+    const std::size_t i = run_index(row, x);
+    const Run old = row[i];
+    if (old.gid == gid) return;
+    const int old_end = (i + 1 == row.size()) ? m_width : row[i + 1].x;
+
+    // the run is split into at most three pieces
+    Run pieces[3];
+    std::size_t count = 0;
+    if (x > old.x) pieces[count++] = old;
+    pieces[count].x = x;
+    pieces[count++].gid = gid;
+    if (x + 1 < old_end) {
+        pieces[count].x = x + 1;
+        pieces[count++].gid = old.gid;
+    }
+    row.erase(row.begin() + std::ptrdiff_t(i));
+    row.insert(row.begin() + std::ptrdiff_t(i), pieces, pieces + count);
+
+    // the new cell may join either neighbor
+    std::size_t j = (i == 0) ? 0 : i - 1;
+    std::size_t last = std::min(i + count, row.size() - 1);
+    while (j < last) {
+        if (row[j].gid != row[j + 1].gid) {
+            ++j;
+            continue;
+        }
+        row.erase(row.begin() + std::ptrdiff_t(j + 1));
+        --last;
+    }
+}
+
+/* private */ void RunLengthTileMatrix::encode_row(int y, const int * gids) {
+    RunRow & row = m_rows[std::size_t(y)];
+    row.clear();
+    for (int x = 0; x != m_width; ++x) {
+        if (!row.empty() && row.back().gid == gids[x]) continue;
+        Run run;
+        run.x = x;
+        run.gid = gids[x];
+        row.push_back(run);
+    }
+    if (row.empty()) row.emplace_back();
+}
+
+/* private */ void RunLengthTileMatrix::promote() const {
+    m_promoted.resize(std::size_t(m_width*m_height));
+    for (int y = 0; y != m_height; ++y) {
+        const RunRow & row = m_rows[std::size_t(y)];
+        for (std::size_t i = 0; i != row.size(); ++i) {
+            const int run_end = (i + 1 == row.size()) ? m_width : row[i + 1].x;
+            std::fill(m_promoted.begin() + (y*m_width + row[i].x),
+                      m_promoted.begin() + (y*m_width + run_end), row[i].gid);
+        }
+    }
+    // runs are not needed again until compact
+    for (RunRow & row : m_rows) {
+        row.clear();
+        row.shrink_to_fit();
+    }
+}
+
+// <--------------------------- ChunkedTileMatrix ---------------------------->
+
+/* static */ constexpr const int ChunkedTileMatrix::k_chunk_size;
+
+ChunkedTileMatrix::ChunkedTileMatrix
+    (const sf::IntRect & bounds_, std::pmr::memory_resource * resource):
+    m_chunks(resource),
+    m_bounds(bounds_)
+{}
+
+int ChunkedTileMatrix::gid_at(int x, int y) const {
+    const Chunk * chunk = find_chunk(x, y);
+    if (!chunk) return 0;
+    return chunk->gids[std::size_t(
+        to_chunk_local(x) + to_chunk_local(y)*k_chunk_size)];
+}
+
+void ChunkedTileMatrix::set_gid(int x, int y, int gid) {
+    auto key = to_key(to_chunk(x), to_chunk(y));
+    auto itr = m_chunks.find(key);
+    if (itr == m_chunks.end()) {
+        // clearing a tile that was never there
+        if (gid == 0) return;
+        itr = m_chunks.insert(std::make_pair(key, Chunk())).first;
+    }
+    if (gid != 0) extend_bounds(x, y);
+    Chunk & chunk = itr->second;
+    int & cell = chunk.gids[std::size_t(
+        to_chunk_local(x) + to_chunk_local(y)*k_chunk_size)];
+    if (cell == 0 && gid != 0) ++chunk.occupied;
+    if (cell != 0 && gid == 0) --chunk.occupied;
+    cell = gid;
+    if (chunk.occupied == 0) {
+        m_chunks.erase(itr);
+    }
+}
+
+void ChunkedTileMatrix::read_row(int x, int y, int length, int * out) const {
+    const int local_y = to_chunk_local(y);
+    int * const out_end = out + length;
+    while (out != out_end) {
+        // copy as much as one chunk row allows in a single go
+        const int local_x = to_chunk_local(x);
+        const int run = std::min(int(out_end - out), k_chunk_size - local_x);
+        if (const Chunk * chunk = find_chunk(x, y)) {
+            const int * row = &chunk->gids[std::size_t(local_y*k_chunk_size + local_x)];
+            std::copy(row, row + run, out);
+        } else {
+            std::fill(out, out + run, 0);
+        }
+        out += run;
+        x   += run;
+    }
+}
+
+/* private static */ ChunkedTileMatrix::ChunkKey ChunkedTileMatrix::to_key
+    (int chunk_x, int chunk_y)
+{
+    return (ChunkKey(std::uint32_t(chunk_x)) << 32) | ChunkKey(std::uint32_t(chunk_y));
+}
+
+/* private static */ int ChunkedTileMatrix::to_chunk(int tile_pos) {
+    return (tile_pos >= 0) ? tile_pos / k_chunk_size
+                           : -((-tile_pos + k_chunk_size - 1) / k_chunk_size);
+}
+
+/* private static */ int ChunkedTileMatrix::to_chunk_local(int tile_pos)
+    { return tile_pos - to_chunk(tile_pos)*k_chunk_size; }
+
+/* private */ const ChunkedTileMatrix::Chunk * ChunkedTileMatrix::find_chunk
+    (int x, int y) const
+{
+    auto itr = m_chunks.find(to_key(to_chunk(x), to_chunk(y)));
+    if (itr == m_chunks.end()) return nullptr;
+    return &itr->second;
+}
+
+/* private */ void ChunkedTileMatrix::extend_bounds(int x, int y) {
+    if (m_bounds.width == 0 || m_bounds.height == 0) {
+        m_bounds = sf::IntRect(x, y, 1, 1);
+        return;
+    }
+    int right  = std::max(m_bounds.left + m_bounds.width , x + 1);
+    int bottom = std::max(m_bounds.top  + m_bounds.height, y + 1);
+    m_bounds.left   = std::min(m_bounds.left, x);
+    m_bounds.top    = std::min(m_bounds.top , y);
+    m_bounds.width  = right  - m_bounds.left;
+    m_bounds.height = bottom - m_bounds.top ;
+}
+
+// ----------------------------------------------------------------------------
+
+std::unique_ptr<TileMatrix> make_tile_matrix
+    (TileLayerStorage storage, int width, int height,
+     std::pmr::memory_resource * resource, bool promote_when_written,
+     bool promote_when_read)
+{
+    switch (storage) {
+    case TileLayerStorage::k_row_major:
+        return std::make_unique<DenseTileMatrix>(width, height, resource);
+    case TileLayerStorage::k_blocked:
+        return std::make_unique<BlockedTileMatrix>(width, height, resource);
+    case TileLayerStorage::k_palette:
+        return std::make_unique<PaletteTileMatrix>(width, height, resource);
+    case TileLayerStorage::k_run_length:
+        return std::make_unique<RunLengthTileMatrix>
+            (width, height, promote_when_written, promote_when_read, resource);
+    }
+    throw std::invalid_argument("make_tile_matrix: unknown storage layout.");
+}
+
+} // end of tmap namespace
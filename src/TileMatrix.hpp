@@ -0,0 +1,454 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/MapLoadOptions.hpp>
+
+#include <SFML/Graphics/Rect.hpp>
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+
+#include <cassert>
+
+namespace tmap {
+
+/** A single cell of a tile matrix changing from one gid to another, as
+ *  passed to whatever is kept up to date alongside the matrix.
+ */
+struct TileChange {
+    int x = 0;
+    int y = 0;
+    int old_gid = 0;
+    int new_gid = 0;
+};
+
+/** A TileMatrix is the storage behind a TileLayer, it knows only about gids
+ *  and nothing of tilesets. @n
+ *  Reads outside of bounds() are only defined for matrices which say so.
+ */
+class TileMatrix {
+public:
+    virtual ~TileMatrix();
+
+    /** @returns the gid at the given tile position */
+    virtual int gid_at(int x, int y) const = 0;
+
+    /** Sets the gid at the given tile position, a gid of zero clears the
+     *  tile.
+     */
+    virtual void set_gid(int x, int y, int gid) = 0;
+
+    /** Copies a horizontal run of gids into a caller provided buffer.
+     *  @param x first column to copy
+     *  @param y row to copy from
+     *  @param length number of gids to copy
+     *  @param out buffer to write gids to, must have room for length gids
+     */
+    virtual void read_row(int x, int y, int length, int * out) const = 0;
+
+    /** Copies a rectangle of gids into a caller provided buffer, in row-major
+     *  order. Matrices are free to visit their cells in whatever order suits
+     *  their layout best.
+     *  @param region area to copy, in tiles
+     *  @param out buffer with room for region.width*region.height gids
+     */
+    virtual void read_region(const sf::IntRect & region, int * out) const;
+
+    /** Sets a rectangle of gids from a buffer in row-major order, as when a
+     *  layer is loaded.
+     *  @param region area to set, in tiles
+     *  @param gids   region.width*region.height gids
+     */
+    virtual void write_region(const sf::IntRect & region, const int * gids);
+
+    /** @returns the matrix's own storage for row y, as plain gids which may
+     *           be written to directly (as a loader would), or nullptr if
+     *           cells are not kept that way, which is the default
+     */
+    virtual int * row_data(int /* y */) { return nullptr; }
+
+    /** @returns a rectangle, in tiles, containing every tile this matrix
+     *           stores; this may be larger than the smallest such rectangle
+     *           (chunked matrices keep the area Tiled gave them, and do not
+     *           shrink as chunks are released)
+     */
+    virtual sf::IntRect bounds() const = 0;
+
+    /** @returns true if cells may only be set inside of bounds(), false if
+     *           setting a cell outside of them grows the bounds instead
+     */
+    virtual bool has_fixed_bounds() const { return true; }
+
+    /** Releases whatever memory the current contents do not need, by default
+     *  there is nothing to release.
+     */
+    virtual void compact() {}
+};
+
+// ----------------------------------------------------------------------------
+
+/** Row-major storage for a finite (non-infinite) tile layer, every cell of
+ *  the layer is present.
+ */
+class DenseTileMatrix final : public TileMatrix {
+public:
+    DenseTileMatrix() {}
+
+    /** @param resource where cells are allocated from */
+    DenseTileMatrix(int width, int height,
+                    std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+    int gid_at(int x, int y) const override { return m_gids[index_of(x, y)]; }
+
+    void set_gid(int x, int y, int gid) override { m_gids[index_of(x, y)] = gid; }
+
+    void read_row(int x, int y, int length, int * out) const override;
+
+    void write_region(const sf::IntRect & region, const int * gids) override;
+
+    int * row_data(int y) override { return m_gids.data() + index_of(0, y); }
+
+    sf::IntRect bounds() const override;
+
+private:
+    std::size_t index_of(int x, int y) const {
+        assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+        return std::size_t(y*m_width + x);
+    }
+
+    int m_width = 0;
+    int m_height = 0;
+    std::pmr::vector<int> m_gids;
+};
+
+// ----------------------------------------------------------------------------
+
+/** Storage for a finite tile layer, where cells are kept in small square
+ *  blocks. Blocks are laid out row-major, cells within a block are in
+ *  Z-order (Morton order). @n
+ *  Nearby cells in any direction tend to share a cache line, which favors
+ *  neighborhood queries and column-wise passes over a tall map.
+ */
+class BlockedTileMatrix final : public TileMatrix {
+public:
+    static constexpr const int k_block_size = 8;
+
+    BlockedTileMatrix() {}
+
+    /** @param resource where cells are allocated from */
+    BlockedTileMatrix(int width, int height,
+                      std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+    int gid_at(int x, int y) const override
+        { return m_gids[index_of(x, y)]; }
+
+    void set_gid(int x, int y, int gid) override
+        { m_gids[index_of(x, y)] = gid; }
+
+    void read_row(int x, int y, int length, int * out) const override;
+
+    void read_region(const sf::IntRect & region, int * out) const override;
+
+    void write_region(const sf::IntRect & region, const int * gids) override;
+
+    sf::IntRect bounds() const override
+        { return sf::IntRect(0, 0, m_width, m_height); }
+
+private:
+    static constexpr const int k_block_shift = 3;
+    static constexpr const int k_block_mask  = k_block_size - 1;
+    static constexpr const int k_block_area  = k_block_size*k_block_size;
+    static_assert(k_block_size == (1 << k_block_shift), "");
+
+    // spreads bits of a block local position, so that two spread positions
+    // can be interleaved
+    static std::size_t spread_bits(int block_local_pos) {
+        static constexpr const std::uint8_t k_spread[k_block_size] =
+            { 0b000000, 0b000001, 0b000100, 0b000101,
+              0b010000, 0b010001, 0b010100, 0b010101 };
+        return k_spread[block_local_pos & k_block_mask];
+    }
+
+    std::size_t block_of(int x, int y) const {
+        return std::size_t((y >> k_block_shift)*m_blocks_across
+                           + (x >> k_block_shift));
+    }
+
+    static std::size_t index_in_block(int x, int y)
+        { return spread_bits(x) | (spread_bits(y) << 1); }
+
+    std::size_t index_of(int x, int y) const {
+        assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+        return block_of(x, y)*k_block_area + index_in_block(x, y);
+    }
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_blocks_across = 0;
+    std::pmr::vector<int> m_gids;
+};
+
+// ----------------------------------------------------------------------------
+
+/** Storage for a finite tile layer, where each cell is an index into a
+ *  palette of the gids the layer uses. Indices are packed row-major into
+ *  64-bit words, using 1, 2, 4, 8, 16 (or if it must, 32) bits each, so an
+ *  index never straddles two words. @n
+ *  Setting a gid not yet in the palette adds it, widening every index if
+ *  the palette outgrows the current width. Gids which are no longer used
+ *  stay in the palette until compact is called.
+ */
+class PaletteTileMatrix final : public TileMatrix {
+public:
+    PaletteTileMatrix() {}
+
+    /** @param resource where cells and the palette are allocated from */
+    PaletteTileMatrix(int width, int height,
+                      std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+    int gid_at(int x, int y) const override
+        { return m_palette[index_at(cell_of(x, y))]; }
+
+    void set_gid(int x, int y, int gid) override;
+
+    void read_row(int x, int y, int length, int * out) const override;
+
+    sf::IntRect bounds() const override
+        { return sf::IntRect(0, 0, m_width, m_height); }
+
+    /** Drops unused gids from the palette, and narrows indices if the
+     *  palette now fits in fewer bits.
+     */
+    void compact() override;
+
+    /** @returns number of bits used by each cell */
+    int bits_per_cell() const { return m_bits; }
+
+    /** @returns number of gids in the palette */
+    std::size_t palette_size() const { return m_palette.size(); }
+
+private:
+    using Word = std::uint64_t;
+
+    static constexpr const int k_word_bits = 64;
+
+    // smallest width (of those allowed) which fits palette_size indices
+    static int bits_for(std::size_t palette_size);
+
+    std::size_t cell_of(int x, int y) const {
+        assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
+        return std::size_t(y*m_width + x);
+    }
+
+    std::size_t index_at(std::size_t cell) const {
+        const std::size_t bit = cell*std::size_t(m_bits);
+        assert(bit / k_word_bits < m_words.size());
+        return std::size_t((m_words[bit / k_word_bits] >> (bit % k_word_bits))
+                           & m_mask);
+    }
+
+    void set_index_at(std::size_t cell, std::size_t index);
+
+    // repacks every cell with new indices, at a new width
+    void repack(int new_bits, const std::pmr::vector<std::uint32_t> & old_to_new);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_bits = 1;
+    Word m_mask = 1;
+    std::pmr::vector<Word> m_words;
+    std::pmr::vector<int> m_palette;
+    std::pmr::unordered_map<int, std::uint32_t> m_palette_indices;
+};
+
+// ----------------------------------------------------------------------------
+
+/** Storage for a finite tile layer which is rarely touched, each row is kept
+ *  as runs of the same gid. A cell is found by binary search over its row's
+ *  runs. @n
+ *  Layers which turn out to be "hot" may be promoted: after enough writes
+ *  (one per k_promote_after_writes cells), or if enabled, enough rows read
+ *  (drawing reads rows, k_promote_after_passes times the layer's height)
+ *  cells are moved to a plain row-major array, and stay there until compact
+ *  is called.
+ *  @warning if promotion on reads is enabled, reads change the matrix, and
+ *           are not safe to make from more than one thread at a time
+ */
+class RunLengthTileMatrix final : public TileMatrix {
+public:
+    static constexpr const int k_promote_after_writes = 16;
+    static constexpr const int k_promote_after_passes = 4;
+
+    RunLengthTileMatrix() {}
+
+    /** @param promote_when_written if true switches to row-major storage
+     *                              when often written to
+     *  @param promote_when_read    if true switches to row-major storage
+     *                              when often read from (see the warning
+     *                              above)
+     *  @param resource             where runs (and cells) are allocated from
+     */
+    RunLengthTileMatrix
+        (int width, int height, bool promote_when_written = true,
+         bool promote_when_read = false,
+         std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+    int gid_at(int x, int y) const override;
+
+    void set_gid(int x, int y, int gid) override;
+
+    void read_row(int x, int y, int length, int * out) const override;
+
+    /** Rows covered whole are encoded anew, this does not count toward
+     *  promotion.
+     */
+    void write_region(const sf::IntRect & region, const int * gids) override;
+
+    sf::IntRect bounds() const override
+        { return sf::IntRect(0, 0, m_width, m_height); }
+
+    /** Goes back to runs, if the matrix was promoted, and releases memory
+     *  rows do not use.
+     */
+    void compact() override;
+
+    bool is_promoted() const { return !m_promoted.empty(); }
+
+    /** @returns total number of runs, across all rows */
+    std::size_t run_count() const;
+
+private:
+    // covers [x next run's x), the last run of a row covers to its end
+    struct Run {
+        int x = 0;
+        int gid = 0;
+    };
+
+    using RunRow = std::pmr::vector<Run>;
+
+    // index of the run covering x
+    static std::size_t run_index(const RunRow &, int x);
+
+    void set_run_gid(int x, int y, int gid);
+
+    void encode_row(int y, const int * gids);
+
+    void promote() const;
+
+    int m_width = 0;
+    int m_height = 0;
+    bool m_promote_when_written = true;
+    bool m_promote_when_read = false;
+
+    // promotion changes how cells are kept, not what they are
+    mutable std::pmr::vector<RunRow> m_rows;
+    mutable std::pmr::vector<int> m_promoted;
+    mutable long m_writes = 0;
+    mutable long m_rows_read = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+/** Sparse storage for Tiled's "infinite" maps. Tiles are kept in fixed size
+ *  square chunks, and only chunks with at least one tile in them are kept.
+ *  @n
+ *  Any position may be read, positions without a chunk have no tile.
+ *  Chunks are allocated on demand when a tile is set, and released when
+ *  their last tile is cleared.
+ */
+class ChunkedTileMatrix final : public TileMatrix {
+public:
+    static constexpr const int k_chunk_size = 16;
+
+    ChunkedTileMatrix() {}
+
+    /** @param bounds_  area which the layer (as written by Tiled) covers,
+     *                  this is extended whenever a tile is set outside of it
+     *  @param resource where chunks are allocated from
+     */
+    explicit ChunkedTileMatrix
+        (const sf::IntRect & bounds_,
+         std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+    int gid_at(int x, int y) const override;
+
+    void set_gid(int x, int y, int gid) override;
+
+    void read_row(int x, int y, int length, int * out) const override;
+
+    /** @returns the area Tiled gave, grown to take in every tile set since,
+     *           it is never shrunk
+     */
+    sf::IntRect bounds() const override { return m_bounds; }
+
+    bool has_fixed_bounds() const override { return false; }
+
+    /** @returns number of chunks currently allocated */
+    std::size_t chunk_count() const { return m_chunks.size(); }
+
+private:
+    using ChunkKey = std::uint64_t;
+
+    struct Chunk {
+        std::array<int, k_chunk_size*k_chunk_size> gids {};
+        int occupied = 0;
+    };
+
+    static ChunkKey to_key(int chunk_x, int chunk_y);
+
+    // both to floor, negative positions are allowed
+    static int to_chunk(int tile_pos);
+    static int to_chunk_local(int tile_pos);
+
+    const Chunk * find_chunk(int x, int y) const;
+
+    void extend_bounds(int x, int y);
+
+    std::pmr::unordered_map<ChunkKey, Chunk> m_chunks;
+    sf::IntRect m_bounds;
+};
+
+// ----------------------------------------------------------------------------
+
+/** @returns a new, empty (all cells without tiles) matrix for a finite layer
+ *           using the given storage layout
+ *  @param resource where the matrix's cells are allocated from
+ *  @param promote_when_written only used by run length matrices
+ *  @param promote_when_read    only used by run length matrices
+ */
+std::unique_ptr<TileMatrix> make_tile_matrix
+    (TileLayerStorage storage, int width, int height,
+     std::pmr::memory_resource * resource = std::pmr::get_default_resource(),
+     bool promote_when_written = true, bool promote_when_read = false);
+
+} // end of tmap namespace
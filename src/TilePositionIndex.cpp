@@ -0,0 +1,153 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include "TilePositionIndex.hpp"
+#include "TileMatrix.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+namespace {
+
+using PackedPosition = std::uint64_t;
+
+constexpr const std::uint32_t k_sign_flip = 0x80000000u;
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+TilePositionIndex::TilePositionIndex(const TileMatrix & matrix) {
+    const sf::IntRect bounds = matrix.bounds();
+    std::vector<int> row_gids(std::size_t(bounds.width));
+    for (int y = bounds.top; y != bounds.top + bounds.height; ++y) {
+        matrix.read_row(bounds.left, y, bounds.width, row_gids.data());
+        for (int i = 0; i != bounds.width; ++i) {
+            const int gid = row_gids[std::size_t(i)];
+            if (gid == TilePropertiesInterface::k_no_tile) continue;
+            // visited in row-major order, so lists come out sorted
+            m_positions[gid].push_back(pack(bounds.left + i, y));
+        }
+    }
+}
+
+void TilePositionIndex::move(int x, int y, int old_gid, int new_gid) {
+    if (old_gid == new_gid) return;
+    const PackedPosition pos = pack(x, y);
+    if (old_gid != TilePropertiesInterface::k_no_tile) {
+        auto itr = m_positions.find(old_gid);
+        assert(itr != m_positions.end());
+        auto & list = itr->second;
+        auto pitr = std::lower_bound(list.begin(), list.end(), pos);
+        assert(pitr != list.end() && *pitr == pos);
+        list.erase(pitr);
+        if (list.empty()) m_positions.erase(itr);
+    }
+    if (new_gid != TilePropertiesInterface::k_no_tile) {
+        auto & list = m_positions[new_gid];
+        list.insert(std::upper_bound(list.begin(), list.end(), pos), pos);
+    }
+}
+
+void TilePositionIndex::move(const std::vector<TileChange> & changes) {
+    // (gid, position) pairs, to be taken out of and put into lists
+    std::vector<std::pair<int, PackedPosition>> removed, added;
+    for (const TileChange & change : changes) {
+        if (change.old_gid == change.new_gid) continue;
+        const PackedPosition pos = pack(change.x, change.y);
+        if (change.old_gid != TilePropertiesInterface::k_no_tile)
+            removed.emplace_back(change.old_gid, pos);
+        if (change.new_gid != TilePropertiesInterface::k_no_tile)
+            added.emplace_back(change.new_gid, pos);
+    }
+    std::sort(removed.begin(), removed.end());
+    std::sort(added  .begin(), added  .end());
+
+    PositionList scratch, positions;
+    for (auto itr = removed.begin(); itr != removed.end(); ) {
+        const int gid = itr->first;
+        auto last = std::find_if(itr, removed.end(),
+            [gid](const std::pair<int, PackedPosition> & pair) { return pair.first != gid; });
+        positions.clear();
+        for (; itr != last; ++itr) positions.push_back(itr->second);
+
+        auto litr = m_positions.find(gid);
+        assert(litr != m_positions.end());
+        scratch.clear();
+        std::set_difference(litr->second.begin(), litr->second.end(),
+                            positions.begin(), positions.end(),
+                            std::back_inserter(scratch));
+        if (scratch.empty()) m_positions.erase(litr);
+        else                 litr->second.swap(scratch);
+    }
+    for (auto itr = added.begin(); itr != added.end(); ) {
+        const int gid = itr->first;
+        auto last = std::find_if(itr, added.end(),
+            [gid](const std::pair<int, PackedPosition> & pair) { return pair.first != gid; });
+        positions.clear();
+        for (; itr != last; ++itr) positions.push_back(itr->second);
+
+        auto & list = m_positions[gid];
+        scratch.clear();
+        std::merge(list.begin(), list.end(), positions.begin(), positions.end(),
+                   std::back_inserter(scratch));
+        list.swap(scratch);
+    }
+}
+
+void TilePositionIndex::append_positions
+    (int gid, std::vector<TilePosition> & out) const
+{
+    auto itr = m_positions.find(gid);
+    if (itr == m_positions.end()) return;
+    append_unpacked(itr->second, out);
+}
+
+/* private static */ PackedPosition TilePositionIndex::pack(int x, int y) {
+    return (PackedPosition(std::uint32_t(y) ^ k_sign_flip) << 32)
+           | PackedPosition(std::uint32_t(x) ^ k_sign_flip);
+}
+
+/* private static */ TilePositionIndex::TilePosition
+    TilePositionIndex::unpack(PackedPosition packed)
+{
+    TilePosition rv;
+    rv.x = int(std::uint32_t(packed & 0xFFFFFFFFu) ^ k_sign_flip);
+    rv.y = int(std::uint32_t(packed >> 32) ^ k_sign_flip);
+    return rv;
+}
+
+/* private static */ void TilePositionIndex::append_unpacked
+    (const PositionList & list, std::vector<TilePosition> & out)
+{
+    out.reserve(out.size() + list.size());
+    for (PackedPosition packed : list)
+        out.push_back(unpack(packed));
+}
+
+} // end of tmap namespace
@@ -0,0 +1,131 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#pragma once
+
+#include <tmap/TilePropertiesInterface.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+namespace tmap {
+
+class TileMatrix;
+struct TileChange;
+
+/** An inverted index of a tile layer, from each gid to the positions of all
+ *  tiles with that gid. Positions are packed into a single integer each and
+ *  kept sorted row-major (by y, then x). @n
+ *  Empty cells (no tile) are not indexed.
+ */
+class TilePositionIndex {
+public:
+    using TilePosition = TilePropertiesInterface::TilePosition;
+
+    TilePositionIndex() {}
+
+    /** Indexes every tile currently in the matrix. */
+    explicit TilePositionIndex(const TileMatrix &);
+
+    /** Records that the tile at (x, y) changed from old_gid to new_gid. */
+    void move(int x, int y, int old_gid, int new_gid);
+
+    /** Records many changes at once, each gid's list is merged with its
+     *  changes in a single pass.
+     */
+    void move(const std::vector<TileChange> &);
+
+    /** Appends positions of all tiles with the given gid, in row-major
+     *  order.
+     */
+    void append_positions(int gid, std::vector<TilePosition> & out) const;
+
+    /** Appends positions of all tiles whose gid satisfies the predicate, in
+     *  row-major order. The predicate is called once for each distinct gid
+     *  in the layer.
+     *  @param f callable with signature: bool f(int gid)
+     */
+    template <typename Func>
+    void append_positions_if(Func && f, std::vector<TilePosition> & out) const;
+
+private:
+    using PackedPosition = std::uint64_t;
+    using PositionList   = std::vector<PackedPosition>;
+
+    // packs so that packed positions sort in row-major order, negative
+    // positions included
+    static PackedPosition pack(int x, int y);
+
+    static TilePosition unpack(PackedPosition);
+
+    static void append_unpacked(const PositionList &, std::vector<TilePosition> & out);
+
+    // what is left of one gid's list, while lists are merged
+    struct MergeCursor {
+        const PackedPosition * at;
+        const PackedPosition * end;
+    };
+
+    std::unordered_map<int, PositionList> m_positions;
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename Func>
+void TilePositionIndex::append_positions_if
+    (Func && f, std::vector<TilePosition> & out) const
+{
+    std::vector<MergeCursor> heap;
+    std::size_t total = 0;
+    for (const auto & pair : m_positions) {
+        if (pair.second.empty() || !f(pair.first)) continue;
+        heap.push_back(MergeCursor { pair.second.data(),
+                                     pair.second.data() + pair.second.size() });
+        total += pair.second.size();
+    }
+    // each list is already in order, so they are merged (k-way, through a
+    // heap of each list's next position)
+    const auto comes_later =
+        [](const MergeCursor & lhs, const MergeCursor & rhs)
+        { return *lhs.at > *rhs.at; };
+    std::make_heap(heap.begin(), heap.end(), comes_later);
+    out.reserve(out.size() + total);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), comes_later);
+        MergeCursor & next = heap.back();
+        out.push_back(unpack(*next.at));
+        if (++next.at == next.end) {
+            heap.pop_back();
+        } else {
+            std::push_heap(heap.begin(), heap.end(), comes_later);
+        }
+    }
+}
+
+} // end of tmap namespace
@@ -0,0 +1,112 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include <tmap/TilePropertyBinding.hpp>
+
+#include <charconv>
+
+// floating point from_chars is not offered by every standard library yet,
+// where it isn't a stream in the "C" locale stands in
+#ifdef __cpp_lib_to_chars
+#   define MACRO_FLOAT_FROM_CHARS
+#else
+#   include <sstream>
+#   include <locale>
+#endif
+
+namespace {
+
+template <typename T>
+bool parse_integer(const std::string & str, T & out) {
+    const char * beg = str.data();
+    const char * end = beg + str.size();
+    T temp = 0;
+    auto gv = std::from_chars(beg, end, temp);
+    if (gv.ec != std::errc() || gv.ptr != end) return false;
+    out = temp;
+    return true;
+}
+
+// Tiled always writes '.' for the decimal point, so reals are read the same
+// whatever the current C locale is
+template <typename T>
+bool parse_real(const std::string & str, T & out) {
+    T temp = 0;
+#   ifdef MACRO_FLOAT_FROM_CHARS
+    const char * beg = str.data();
+    const char * end = beg + str.size();
+    auto gv = std::from_chars(beg, end, temp);
+    if (gv.ec != std::errc() || gv.ptr != end) return false;
+#   else
+    std::istringstream in(str);
+    in.imbue(std::locale::classic());
+    in >> std::noskipws >> temp;
+    if (in.fail() || in.peek() != std::istringstream::traits_type::eof())
+        return false;
+#   endif
+    out = temp;
+    return true;
+}
+
+} // end of <anonymous> namespace
+
+namespace tmap {
+
+/* vtable anchor */ TilePropertyTableBase::~TilePropertyTableBase() {}
+
+bool parse_tile_property(const std::string & str, bool & out) {
+    if (str == "true" || str == "1") {
+        out = true;
+    } else if (str == "false" || str == "0") {
+        out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_tile_property(const std::string & str, int & out)
+    { return parse_integer(str, out); }
+
+bool parse_tile_property(const std::string & str, unsigned & out)
+    { return parse_integer(str, out); }
+
+bool parse_tile_property(const std::string & str, long & out)
+    { return parse_integer(str, out); }
+
+bool parse_tile_property(const std::string & str, float & out)
+    { return parse_real(str, out); }
+
+bool parse_tile_property(const std::string & str, double & out)
+    { return parse_real(str, out); }
+
+bool parse_tile_property(const std::string & str, std::string & out) {
+    out = str;
+    return true;
+}
+
+} // end of tmap namespace
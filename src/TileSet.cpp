@@ -26,6 +26,7 @@
 
 #include "TileSet.hpp"
 #include "TiXmlHelpers.hpp"
+#include "PropertyKeyTable.hpp"
 
 #include <SFML/Graphics/Sprite.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
@@ -33,6 +34,8 @@
 #include <tinyxml2.h>
 
 #include <stdexcept>
+#include <algorithm>
+#include <tuple>
 #include <cassert>
 
 namespace {
@@ -42,6 +45,15 @@ using InvArg       = std::invalid_argument;
 using TiXmlElement = tinyxml2::XMLElement;
 using XmlRange     = tmap::XmlRange;
 using PropertyMap  = tmap::TileSet::PropertyMap;
+using PropertyKey  = tmap::PropertyKey;
+using PropertyKeyTable = tmap::PropertyKeyTable;
+
+// tile id, key and value, of one tile's property
+struct TileProperty {
+    int tid;
+    PropertyKey key;
+    const char * value;
+};
 
 bool is_dir_slash(char c) { return c == '\\' || c == '/'; }
 
@@ -54,15 +66,21 @@ void fix_path
 std::string make_error_header(const TiXmlElement * el);
 
 void load_properties
-    (std::map<std::string, std::string> & props, const TiXmlElement * props_el);
+    (int tid, const TiXmlElement * props_el, PropertyKeyTable & keys,
+     std::vector<TileProperty> & props);
 
 sf::Vector2i size_in_tiles
     (const sf::Vector2i & tile_size, const sf::Vector2i & image_size,
      int spacing);
 
-std::vector<PropertyMap> load_tile_properties(const TiXmlElement *);
+/** Loads every tile's properties, as a list sorted by tile id and then key.
+ *  If a tile lists a property more than once, only the last one is kept.
+ *  @returns number of tiles described
+ */
+std::size_t load_tile_properties
+    (const TiXmlElement *, PropertyKeyTable &, std::vector<TileProperty> &);
 
-std::vector<std::string> load_tile_types(const TiXmlElement *);
+std::vector<PropertyKey> load_tile_types(const TiXmlElement *, PropertyKeyTable &);
 
 } // end of <anonymous> namespace
 
@@ -82,17 +100,43 @@ TileSet::~TileSet() {}
 void TileSet::set_referer(const std::string & referer)
     { m_referer = referer; }
 
+void TileSet::set_property_keys(std::shared_ptr<PropertyKeyTable> keys)
+    { m_property_keys = keys; }
+
 bool TileSet::load_texture() {
     fix_file_path();
 
-    m_texture = std::make_unique<sf::Texture>();
-    if (!m_texture->loadFromFile(m_filename))
+    sf::Image image;
+    if (!image.loadFromFile(m_filename))
+        return false;
+    return load_texture(image);
+}
+
+bool TileSet::load_texture(const sf::Image & image) {
+    auto texture = std::make_unique<sf::Texture>();
+    if (!texture->loadFromImage(image))
         return false;
 
+    sf::Vector2i tileset_size = ::size_in_tiles(m_tile_size, sf::Vector2i(image.getSize()), m_spacing);
+    std::vector<TileEffect *> tile_effects;
+    tile_effects.resize(std::size_t(tileset_size.x*tileset_size.y),
+                        &NoTileEffect::instance()                 );
+
+    // these will not throw
+    m_tile_effects.swap(tile_effects);
+    m_texture     .swap(texture);
+    // must be done last (spacing and tile size)
+    m_end_gid = m_begin_gid + tileset_size.x*tileset_size.y;
+
+    assert(tileset_size == size_in_tiles());
+    assert(m_tile_effects.size() >= described_tile_count());
     check_invarients();
     return true;
 }
 
+const std::string & TileSet::image_filename() const
+    { return m_filename; }
+
 sf::IntRect TileSet::compute_texture_rect(TileFrame frame) const
     { return compute_texture_rect(frame.m_gid); }
 
@@ -120,14 +164,37 @@ const PropertyMap * TileSet::properties_on_gid(int id) const {
 
 const PropertyMap * TileSet::properties_on(int tid) const {
     if (tid < 0) return nullptr;
-    if (tid >= int(m_properties.size())) return nullptr;
-    return &m_properties[std::size_t(tid)];
+    if (tid >= int(described_tile_count())) return nullptr;
+    LazyPropertyMap & props = m_property_maps[std::size_t(tid)];
+    std::call_once(props.made, [this, tid, &props] {
+        PropertyMap temp;
+        for (auto itr = properties_begin(tid); itr != properties_end(tid); ++itr) {
+            temp[m_property_keys->name_of(itr->key)] = itr->value;
+        }
+        props.map.swap(temp);
+    });
+    return &props.map;
+}
+
+const std::string * TileSet::find_property(int tid, PropertyKey key) const {
+    if (tid < 0) return nullptr;
+    if (tid >= int(described_tile_count())) return nullptr;
+    // tiles seldom have more than a handful of properties
+    auto end = properties_end(tid);
+    auto itr = std::lower_bound(properties_begin(tid), end, key,
+        [](const PropertyEntry & entry, PropertyKey key)
+        { return entry.key < key; });
+    if (itr == end || itr->key != key) return nullptr;
+    return &itr->value;
 }
 
 const std::string & TileSet::type_of(int tid) const {
-    verify_owns_local_id(tid, "type_of");
-    static const std::string k_empty;
-    if (tid >= int(m_tile_types.size())) return k_empty;
+    return m_property_keys->name_of(type_key_of(tid));
+}
+
+PropertyKey TileSet::type_key_of(int tid) const {
+    verify_owns_local_id(tid, "type_key_of");
+    if (tid >= int(m_tile_types.size())) return PropertyKey();
     return m_tile_types[std::size_t(tid)];
 }
 
@@ -143,9 +210,12 @@ void TileSet::load_from_xml(const TiXmlElement * el) {
     int spacing = 0;
     const char * source = nullptr;
     sf::Vector2i tile_size;
-    std::unique_ptr<sf::Texture> texture_ = nullptr;
-    std::vector<PropertyMap> properties;
-    std::vector<std::string> tile_types;
+    PropertyEntryVector property_entries;
+    OffsetVector property_offsets;
+    std::vector<PropertyKey> tile_types;
+    auto property_keys = m_property_keys;
+    if (!property_keys)
+        property_keys = std::make_shared<PropertyKeyTable>();
     try {
         tile_size.x = read_int_attribute(el, "tilewidth" );
         tile_size.y = read_int_attribute(el, "tileheight");
@@ -170,53 +240,59 @@ void TileSet::load_from_xml(const TiXmlElement * el) {
             throw Error(make_error_header(el) + "No source image specified "
                         "for tileset.");
         }
-        texture_ = std::make_unique<sf::Texture>();
-        std::string fn = source;
-        fix_path(fn, m_referer, fn);
-        if (!texture_->loadFromFile(fn)) {
-            throw Error("TileSet::load_from_xml: cannot load image \"" + fn + "\" (with referer \"" + m_referer + "\")");
+        std::vector<TileProperty> properties;
+        std::size_t tile_count = load_tile_properties(el, *property_keys, properties);
+        property_entries.reserve(properties.size());
+        property_offsets.reserve(tile_count + 1);
+        for (const auto & prop : properties) {
+            while (int(property_offsets.size()) <= prop.tid)
+                property_offsets.push_back(property_entries.size());
+            property_entries.emplace_back(prop.key, prop.value);
         }
-        properties = load_tile_properties(el);
-        tile_types = load_tile_types(el);
+        if (tile_count > 0) {
+            property_offsets.resize(tile_count + 1, property_entries.size());
+        }
+        tile_types = load_tile_types(el, *property_keys);
     } catch (InvArg &) {
         throw Error(make_error_header(el) + "TileSet information contains "
                     "non-integers where integers were expected");
     }
-    std::vector<TileEffect *> tile_effects;
-    sf::Vector2i tileset_size = ::size_in_tiles(tile_size, sf::Vector2i(texture_->getSize()), spacing);
-    tile_effects.resize(std::size_t(tileset_size.x*tileset_size.y),
-                        &NoTileEffect::instance()                 );
-
-    m_filename = source; // may throw
-    fix_file_path();
+    std::string filename = source; // may throw
+    fix_path(filename, m_referer, filename);
+    auto property_maps = std::make_unique<LazyPropertyMap[]>
+        (property_offsets.empty() ? 0 : property_offsets.size() - 1);
 
     // these will not throw
-    m_tile_effects.swap(tile_effects);
-    m_texture     .swap(texture_);
-    m_properties  .swap(properties);
-    m_tile_types  .swap(tile_types);
+    // the image is decoded seperately, until then the tileset has no tiles
+    m_filename        .swap(filename);
+    m_referer.clear();
+    m_tile_effects.clear();
+    m_texture.reset();
+    m_property_entries.swap(property_entries);
+    m_property_offsets.swap(property_offsets);
+    m_tile_types      .swap(tile_types);
+    m_property_keys   .swap(property_keys);
+    m_property_maps   .swap(property_maps);
 
     m_tile_size  = tile_size;
     m_spacing    = spacing;
     m_begin_gid  = first_gid;
-    // must be done last (spacing and tile size)
-    m_end_gid    = first_gid + tileset_size.x*tileset_size.y;
+    m_end_gid    = first_gid;
 
-    assert(tileset_size == size_in_tiles());
-    assert(m_tile_effects.size() >= m_properties.size());
     check_invarients();
 }
 
 void TileSet::set_tile_effect
     (const char * name, const char * value, TileEffect * te)
 {
-    assert(m_tile_effects.size() >= m_properties.size());
-    const std::size_t end_index = m_properties.size();
+    assert(m_tile_effects.size() >= described_tile_count());
+    const PropertyKey key = m_property_keys->find(name);
+    if (!key.is_valid()) return;
+    const std::size_t end_index = described_tile_count();
     for (std::size_t i = 0; i != end_index; ++i) {
-        const PropertyMap & prop_map = m_properties[i];
-        auto itr = prop_map.find(name);
-        if (itr == prop_map.end()) continue;
-        if (itr->second != value && value[0] != '\0') continue;
+        const std::string * prop_value = find_property(int(i), key);
+        if (!prop_value) continue;
+        if (*prop_value != value && value[0] != '\0') continue;
         m_tile_effects[i] = te;
     }
     check_invarients();
@@ -234,21 +310,21 @@ TileSet::IterValuePair TileSet::find_tile_effect_ref_and_name
                prev.tile_effect <  &m_tile_effects.back()  );
         first = prev.tile_effect + 1;
     }
-    while (first != &m_tile_effects.back()) {
+    const PropertyKey key = m_property_keys->find(name);
+    while (key.is_valid() && first != &m_tile_effects.back()) {
         assert(first - &m_tile_effects.front() >= 0);
         const std::size_t index = std::size_t(first - &m_tile_effects.front());
-        if (index == m_properties.size())
+        if (index == described_tile_count())
             break;
-        const auto & props = m_properties[index];
-        auto pmap_itr = props.find(name);
-        if (pmap_itr == props.end()) {
+        const std::string * value = find_property(int(index), key);
+        if (!value) {
             ++first;
             continue;
         } else {
             IterValuePair rv = prev;
             int gid = int(end - first) + m_begin_gid;
             rv.tile_effect = first;
-            rv.value = &pmap_itr->second;
+            rv.value = value;
             rv.tile_frame = TileFrame::construct_privately(gid);
             check_invarients();
             return rv;
@@ -259,6 +335,21 @@ TileSet::IterValuePair TileSet::find_tile_effect_ref_and_name
     return IterValuePair();
 }
 
+/* private */ std::size_t TileSet::described_tile_count() const
+    { return m_property_offsets.empty() ? 0 : m_property_offsets.size() - 1; }
+
+/* private */ const TileSet::PropertyEntry * TileSet::properties_begin
+    (int tid) const
+{
+    return m_property_entries.data() + m_property_offsets[std::size_t(tid)];
+}
+
+/* private */ const TileSet::PropertyEntry * TileSet::properties_end
+    (int tid) const
+{
+    return m_property_entries.data() + m_property_offsets[std::size_t(tid) + 1];
+}
+
 /* private */ void TileSet::fix_file_path() {
     if (m_referer.empty()) return;
 
@@ -391,12 +482,14 @@ std::string make_error_header(const TiXmlElement * el) {
 }
 
 void load_properties
-    (std::map<std::string, std::string> & props, const TiXmlElement * props_el)
+    (int tid, const TiXmlElement * props_el, PropertyKeyTable & keys,
+     std::vector<TileProperty> & props)
 {
     for (const TiXmlElement & el : XmlRange(props_el, "property")) {
         if (!el.Attribute("name") || !el.Attribute("value"))
             throw std::runtime_error("Both name and value must be specified.");
-        props[el.Attribute("name")] = el.Attribute("value");
+        props.push_back(TileProperty
+            { tid, keys.intern(el.Attribute("name")), el.Attribute("value") });
     }
 }
 
@@ -409,25 +502,41 @@ sf::Vector2i size_in_tiles
                         image_size.y / (tile_size.y + spacing));
 }
 
-std::vector<PropertyMap> load_tile_properties(const TiXmlElement * tileset_el) {
+std::size_t load_tile_properties
+    (const TiXmlElement * tileset_el, PropertyKeyTable & keys,
+     std::vector<TileProperty> & props)
+{
     using XmlEl = TiXmlElement;
-    return load_tiles<PropertyMap>(tileset_el, []
-        (const XmlEl & tile_el, PropertyMap & props)
-    {
+    std::size_t tile_count = 0;
+    for (const XmlEl & tile_el : XmlRange(tileset_el, "tile")) {
+        int tid = tmap::read_int_attribute(&tile_el, "id");
+        tile_count = std::max(tile_count, std::size_t(tid) + 1);
         for (const XmlEl & props_el : XmlRange(tile_el, "properties")) {
-            load_properties(props, &props_el);
+            load_properties(tid, &props_el, keys, props);
         }
-    });
+    }
+    // stable, so that later duplicates stay after earlier ones
+    std::stable_sort(props.begin(), props.end(),
+        [](const TileProperty & lhs, const TileProperty & rhs)
+        { return std::tie(lhs.tid, lhs.key) < std::tie(rhs.tid, rhs.key); });
+    // last one in wins
+    auto rend = std::unique(props.rbegin(), props.rend(),
+        [](const TileProperty & lhs, const TileProperty & rhs)
+        { return lhs.tid == rhs.tid && lhs.key == rhs.key; });
+    props.erase(props.begin(), rend.base());
+    return tile_count;
 }
 
-std::vector<std::string> load_tile_types(const TiXmlElement * el) {
+std::vector<PropertyKey> load_tile_types
+    (const TiXmlElement * el, PropertyKeyTable & keys)
+{
     using XmlEl = TiXmlElement;
-    return load_tiles<std::string>(el, []
-        (const XmlEl & tile_el, std::string & typename_)
+    return load_tiles<PropertyKey>(el, [&keys]
+        (const XmlEl & tile_el, PropertyKey & type_key)
     {
         const auto * gv = tile_el.Attribute("type");
         if (!gv) return;
-        typename_ = gv;
+        type_key = keys.intern(gv);
     });
 }
 
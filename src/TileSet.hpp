@@ -28,11 +28,13 @@
 
 #include <SFML/System/Vector2.hpp>
 #include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/Sprite.hpp>
 
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
 
 #include <tmap/TileEffect.hpp>
 
@@ -41,6 +43,8 @@
 
 namespace tmap {
 
+class PropertyKeyTable;
+
 class TileSet final : public TileSetInterface {
 public:
     using IterValuePair = TiledMapImpl::IterValuePair;
@@ -55,10 +59,34 @@ public:
 
     void set_referer(const std::string & referer);
 
+    /** Sets the map-wide table which property and type names are interned
+     *  into, if none is given before loading, the tileset makes its own.
+     */
+    void set_property_keys(std::shared_ptr<PropertyKeyTable>);
+
+    /** Decodes the tileset's image and then uploads it as its texture.
+     *  @return false if the image cannot be loaded
+     */
     bool load_texture();
 
+    /** Uploads an already decoded image as the tileset's texture, which
+     *  gives the tileset its tiles. This must be called from the thread
+     *  that draws.
+     *  @param image decoded from image_filename()
+     *  @return false if the texture cannot be made
+     */
+    bool load_texture(const sf::Image & image);
+
+    /** Reads everything the tileset's XML describes, except the image itself
+     *  which is left for load_texture. Until then the tileset has no tiles.
+     */
     void load_from_xml(const TiXmlElement * el);
 
+    /** @return path of the tileset's image, usable once load_from_xml
+     *          has been called
+     */
+    const std::string & image_filename() const;
+
     void set_tile_effect(const char * name, const char * value, TileEffect * te);
 
     IterValuePair find_tile_effect_ref_and_name
@@ -77,20 +105,44 @@ public:
 
     // <----------------------- tile set information ------------------------->
 
-    /// STL like range
-    int begin_gid() const;
+    /** @copydoc TileSetInterface::begin_gid() */
+    int begin_gid() const override;
 
-    /// STL like, one past the end gid
-    int end_gid() const;
+    /** @copydoc TileSetInterface::end_gid() */
+    int end_gid() const override;
 
     const PropertyMap * properties_on_gid(int gid) const;
 
     /** @copydoc TileSetInterface::properties_on(int) */
     const PropertyMap * properties_on(int tid) const override;
 
+    /** @copydoc TileSetInterface::find_property(int,PropertyKey) */
+    const std::string * find_property(int tid, PropertyKey key) const override;
+
     const std::string & type_of(int tid) const override;
 
+    /** @copydoc TileSetInterface::type_key_of(int) */
+    PropertyKey type_key_of(int tid) const override;
+
 private:
+    struct PropertyEntry {
+        PropertyEntry() {}
+        PropertyEntry(PropertyKey key_, const char * value_):
+            key(key_), value(value_) {}
+        PropertyKey key;
+        std::string value;
+    };
+
+    using PropertyEntryVector = std::vector<PropertyEntry>;
+    using OffsetVector        = std::vector<std::size_t>;
+
+    // number of tiles which the tileset's XML describes
+    std::size_t described_tile_count() const;
+
+    const PropertyEntry * properties_begin(int tid) const;
+
+    const PropertyEntry * properties_end(int tid) const;
+
     void fix_file_path();
 
     // a "non-cached" version of (end_gid() - begin_gid())
@@ -122,9 +174,22 @@ private:
     int m_spacing = 0;
     std::unique_ptr<sf::Texture> m_texture;
 
-    std::vector<PropertyMap > m_properties;
+    // every described tile's properties, one tile after another, each tile's
+    // entries are sorted by key
+    PropertyEntryVector m_property_entries;
+    // where each described tile's entries begin, with one extra for the end
+    OffsetVector m_property_offsets;
+    // an STL map for properties_on, made the first time it is asked for;
+    // call_once keeps this safe for any number of reading threads
+    struct LazyPropertyMap {
+        std::once_flag made;
+        PropertyMap map;
+    };
+    mutable std::unique_ptr<LazyPropertyMap[]> m_property_maps;
+
     std::vector<TileEffect *> m_tile_effects;
-    std::vector<std::string > m_tile_types;
+    std::vector<PropertyKey > m_tile_types;
+    std::shared_ptr<PropertyKeyTable> m_property_keys;
     std::string m_referer;
 };
 
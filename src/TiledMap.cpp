@@ -30,6 +30,8 @@
 
 #include "MapLayer.hpp"
 
+#include <stdexcept>
+
 namespace {
 
 using MapLayerIter      = tmap::TiledMap::MapLayerIter;
@@ -40,10 +42,19 @@ using TileSetPtr        = tmap::TiledMap::TileSetPtr;
 
 namespace tmap {
 
+/* static */ constexpr const int TilePropertiesInterface::k_no_tile;
+
 TilePropertiesInterface::~TilePropertiesInterface() {}
 
 void TiledMap::load_from_file(const char * filename)
-    { m_impl->load_from_file(filename); }
+    { load_from_file(filename, MapLoadOptions()); }
+
+void TiledMap::load_from_file
+    (const char * filename, const MapLoadOptions & options)
+{
+    m_impl->load_from_file(filename, options);
+    rebuild_tile_property_tables();
+}
 
 void TiledMap::set_translation(const sf::Vector2f & offset)
     { m_impl->set_translation(offset); }
@@ -51,6 +62,9 @@ void TiledMap::set_translation(const sf::Vector2f & offset)
 TileSetPtr TiledMap::get_tile_set_for_gid(int gid) const noexcept
     { return m_impl->get_tile_set_for_gid(gid); }
 
+int TiledMap::end_gid() const noexcept
+    { return m_impl->end_gid(); }
+
 const TilePropertiesInterface * TiledMap::find_tile_layer
     (const std::string & name) const
 { return m_impl->find_tile_layer(name); }
@@ -58,12 +72,83 @@ const TilePropertiesInterface * TiledMap::find_tile_layer
 TilePropertiesInterface * TiledMap::find_tile_layer(const std::string & name)
     { return m_impl->find_tile_layer(name); }
 
+PropertyKey TiledMap::property_key(const std::string & name) const
+    { return m_impl->property_key(name); }
+
+TileFlag TiledMap::register_tile_flag(const std::string & property_name) {
+    TiledMapImpl::TileFlagRule rule;
+    rule.property_name = property_name;
+    return m_impl->register_tile_flag(rule);
+}
+
+TileFlag TiledMap::register_tile_flag
+    (const std::string & property_name, const std::string & value)
+{
+    TiledMapImpl::TileFlagRule rule;
+    rule.kind          = TiledMapImpl::TileFlagRule::k_property_equals;
+    rule.property_name = property_name;
+    rule.value         = value;
+    return m_impl->register_tile_flag(rule);
+}
+
+TileFlag TiledMap::register_tile_flag(const std::vector<int> & gids) {
+    TiledMapImpl::TileFlagRule rule;
+    rule.kind = TiledMapImpl::TileFlagRule::k_gid_in_set;
+    rule.gids = gids;
+    return m_impl->register_tile_flag(rule);
+}
+
+void TiledMap::enable_flag_counts(TileFlag flag)
+    { m_impl->enable_flag_counts(flag); }
+
+void TiledMap::compact_tile_layers()
+    { m_impl->compact_tile_layers(); }
+
 const TiledMap::PropertyMap & TiledMap::map_properties() const
     { return m_impl->map_properties(); }
 
 const TiledMap::MapObjectContainer & TiledMap::map_objects() const
     { return m_impl->map_objects(); }
 
+const MapObjectStore & TiledMap::map_object_store() const
+    { return m_impl->map_object_store(); }
+
+void TiledMap::find_objects_in
+    (const sf::FloatRect & area, std::vector<std::size_t> & out,
+     const MapObjectFilter & filter) const
+{
+    m_impl->object_index().find_in
+        (m_impl->map_object_store(), area, filter, out);
+}
+
+void TiledMap::find_objects_at
+    (const sf::Vector2f & point, std::vector<std::size_t> & out,
+     const MapObjectFilter & filter) const
+{
+    m_impl->object_index().find_at
+        (m_impl->map_object_store(), point, filter, out);
+}
+
+void TiledMap::find_objects_near
+    (const sf::Vector2f & center, float radius, std::vector<std::size_t> & out,
+     const MapObjectFilter & filter) const
+{
+    m_impl->object_index().find_near
+        (m_impl->map_object_store(), center, radius, filter, out);
+}
+
+std::string_view TiledMap::object_group_of(std::size_t object_index) const {
+    const auto & store = m_impl->map_object_store();
+    if (object_index >= store.size()) {
+        throw std::out_of_range("TiledMap::object_group_of: object index out "
+                                "of range.");
+    }
+    return store[object_index].group();
+}
+
+const ObjectGeometry & TiledMap::object_geometry() const
+    { return m_impl->object_geometry(); }
+
 MapLayerIter TiledMap::begin()
     { return m_impl->begin(); }
 
@@ -100,7 +185,11 @@ void TiledMap::swap(TiledMap & other)
     { std::swap(m_impl, other.m_impl); }
 
 TiledMap::TiledMap():
-    m_impl(new TiledMapImpl)
+    TiledMap(std::pmr::get_default_resource())
+{}
+
+TiledMap::TiledMap(std::pmr::memory_resource * resource):
+    m_impl(new TiledMapImpl(resource))
 {}
 
 TiledMap::TiledMap(TiledMap && rhs):
@@ -115,6 +204,20 @@ TiledMap & TiledMap::operator = (TiledMap && rhs) {
     return *this;
 }
 
+/* private */ void TiledMap::add_tile_property_table
+    (TilePropertyTableBase * table_ptr)
+{
+    std::unique_ptr<TilePropertyTableBase> table(table_ptr);
+    table->rebuild(*this);
+    m_impl->tile_property_tables().emplace_back(std::move(table));
+}
+
+/* private */ void TiledMap::rebuild_tile_property_tables() {
+    for (auto & table : m_impl->tile_property_tables()) {
+        table->rebuild(*this);
+    }
+}
+
 /* private */ TiledMap::IterValuePair TiledMap::find_tile_effect_ref_and_name
     (const char * name, const IterValuePair & prev)
 { return m_impl->find_tile_effect_ref_and_name(name, prev); }
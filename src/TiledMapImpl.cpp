@@ -26,9 +26,12 @@
 
 #include "TiledMapImpl.hpp"
 #include "ColorLayer.hpp"
+#include "PropertyKeyTable.hpp"
 #include "TileSet.hpp"
 #include "TileLayer.hpp"
 #include "TiXmlHelpers.hpp"
+#include "Parallel.hpp"
+#include "MappedFile.hpp"
 
 #include <common/StringUtil.hpp>
 
@@ -38,6 +41,8 @@
 
 #include <stdexcept>
 #include <memory>
+#include <algorithm>
+#include <thread>
 
 #include <cassert>
 
@@ -52,16 +57,19 @@ using ConstTileSetPtr   = tmap::TiledMapImpl::ConstTileSetPtr;
 using TileSetPtrVector  = tmap::TiledMapImpl::TileSetPtrVector;
 using PropertyMap       = tmap::TiledMapImpl::PropertyMap;
 using MapObject         = tmap::MapObject;
+using MapObjectStore    = tmap::MapObjectStore;
 using MapLayerIter      = tmap::TiledMapImpl::MapLayerIter;
 using MapLayerConstIter = tmap::TiledMapImpl::MapLayerConstIter;
 using XmlRange          = tmap::XmlRange;
+using TileFlagRule      = tmap::TiledMapImpl::TileFlagRule;
+using GidFlagsPtr       = tmap::TileFlagPlanes::GidFlagsPtr;
 
 sf::Color read_color_from(const TiXmlElement * el, const char * attr_name);
 
 void load_whole_map_properties(const TiXmlElement * el, PropertyMap & map);
 
 /** Loads a map object (from Tiled Object layers) from the given element
- *  (whose tag is "object").
+ *  (whose tag is "object"), into the last object of the store.
  *  All attributes (including name and type) outside of the object bounds
  *  (x, y, width and height) are optional. In the case that name or type is
  *  missing, they will be left blank.
@@ -73,30 +81,40 @@ void load_whole_map_properties(const TiXmlElement * el, PropertyMap & map);
  *        keeping the program running.
  *  @param el  XML element to load the object data from.
  *  @param tilesets Some map objects rely on tilesets, so called "tile objects".
- *  @param obj The object to load the XML into, any previous state will be
- *             erased.
+ *  @param store The object store, whose last (freshly added) object the XML
+ *               is loaded into.
  */
 void load_map_object_properties
     (const tinyxml2::XMLElement * el, const TileSetPtrVector & tilesets,
-     MapObject & obj);
+     MapObjectStore & store);
 
 TileSetPtr find_tile_set_for_gid(const TileSetPtrVector &, int gid) noexcept;
 
+/** Evaluates a tile flag's rule for every gid of a map. */
+GidFlagsPtr evaluate_tile_flag
+    (const TileFlagRule &, const TileSetPtrVector &,
+     const tmap::PropertyKeyTable &);
+
 } // end of <anonymous> namespace
 
 namespace tmap {
 
-TiledMapImpl::TiledMapImpl():
-    m_map_width   (0      ),
-    m_map_height  (0      ),
-    m_tile_width  (0      ),
-    m_tile_height (0      ),
-    m_ground_layer(nullptr)
+TiledMapImpl::TiledMapImpl(std::pmr::memory_resource * resource):
+    m_map_width      (0       ),
+    m_map_height     (0       ),
+    m_tile_width     (0       ),
+    m_tile_height    (0       ),
+    m_ground_layer   (nullptr ),
+    m_memory_resource(resource),
+    m_object_store   (resource),
+    m_lazy_views     (std::make_unique<LazyObjectViews>())
 {}
 
 TiledMapImpl::~TiledMapImpl() {}
 
-void TiledMapImpl::load_from_file(const char * filename) {
+void TiledMapImpl::load_from_file
+    (const char * filename, const MapLoadOptions & options)
+{
     TiXmlDocument doc;
     load_xml_file(doc, filename);
 
@@ -159,33 +177,98 @@ void TiledMapImpl::load_from_file(const char * filename) {
 
     // tilesets
     TileSetPtrVector tileset_ptrs;
+    auto property_keys = std::make_shared<PropertyKeyTable>();
     for (const TiXmlElement & tileset_el : XmlRange(map_el, "tileset")) {
         tileset_ptrs.push_back(std::make_shared<TileSet>());
         TileSetPtr ts = tileset_ptrs.back();
         ts->set_referer(filename);
+        ts->set_property_keys(property_keys);
         ts->load_from_xml(&tileset_el);
-        ts->load_texture();
     }
+    // decoding images is the slowest part of loading tilesets, and can be
+    // done away from the drawing thread, textures however cannot
+    std::vector<sf::Image> tileset_images(tileset_ptrs.size());
+    parallel_for(tileset_ptrs.size(), [&tileset_ptrs, &tileset_images](std::size_t i) {
+        const std::string & fn = tileset_ptrs[i]->image_filename();
+        const MappedFile image_file(fn);
+        if (!tileset_images[i].loadFromMemory(image_file.data(), image_file.size()))
+            throw Error("TiledMapImpl::load_from_file: cannot load tileset image \"" + fn + "\"");
+    });
+    for (std::size_t i = 0; i != tileset_ptrs.size(); ++i) {
+        if (!tileset_ptrs[i]->load_texture(tileset_images[i])) {
+            throw Error("TiledMapImpl::load_from_file: cannot make texture from "
+                        "tileset image \"" + tileset_ptrs[i]->image_filename() + "\"");
+        }
+    }
+    tileset_images.clear();
     std::sort(tileset_ptrs.begin(), tileset_ptrs.end(),
               [](const TileSetPtr & lhs, const TileSetPtr & rhs)
     { return lhs->begin_gid() < rhs->begin_gid(); });
 
-    // tile layers
-    TilePropertiesInterface * loaded_ground_layer = nullptr;
-    for (const auto * layer_itr_el = map_el->FirstChildElement("layer");
-         layer_itr_el; layer_itr_el = layer_itr_el->NextSiblingElement("layer"))
-    {
-        auto tl = std::make_unique<TileLayer>();
+    // tile layers and object groups
+    // each decodes on its own, and is then merged in document order
+    std::vector<const TiXmlElement *> layer_els;
+    std::vector<std::unique_ptr<TileLayer>> tile_layers;
+    for (const TiXmlElement & layer_el : XmlRange(map_el, "layer")) {
+        layer_els.push_back(&layer_el);
+        tile_layers.push_back(std::make_unique<TileLayer>());
+    }
+    std::vector<const TiXmlElement *> group_els;
+    std::vector<MapObjectStore> group_objects;
+    for (const TiXmlElement & group_el : XmlRange(map_el, "objectgroup")) {
+        group_els.push_back(&group_el);
+        group_objects.emplace_back(m_memory_resource);
+    }
+    // a map's resource may only be used from many threads if it's known to be
+    // thread safe
+    const std::size_t max_threads =
+        m_memory_resource == std::pmr::new_delete_resource()
+        ? std::size_t(std::thread::hardware_concurrency()) : 1;
+    const std::size_t task_count = layer_els.size() + group_els.size();
+    // a layer may only split its own parsing over the threads no other
+    // layer or group is given, so that no more than max_threads ever run
+    const std::size_t threads_per_layer =
+        std::max(std::size_t(1), max_threads / std::max(std::size_t(1), task_count));
+    parallel_for(task_count, max_threads, [&](std::size_t i) {
+        if (i < layer_els.size()) {
+            tile_layers[i]->load_from_xml(layer_els[i], tileset_ptrs, options,
+                                          m_memory_resource, threads_per_layer);
+            return;
+        }
+        i -= layer_els.size();
+        load_map_object_group(group_els[i], tileset_ptrs, group_objects[i]);
+    });
 
-        tl->load_from_xml(layer_itr_el, tileset_ptrs);
+    TilePropertiesInterface * loaded_ground_layer = nullptr;
+    std::vector<TileLayer *> loaded_tile_layers;
+    for (auto & tl : tile_layers) {
         // tile layers don't know the tile size (which is global), so it must
         // be set seperately
         tl->set_tile_size(float(tile_width), float(tile_height));
 
+        loaded_tile_layers.push_back(tl.get());
         loaded_layers.emplace_back(std::move(tl));
     }
 
-    load_map_objects(map_el, tileset_ptrs);
+    // flags outlive loads, so each must be evaluated again for new tilesets
+    for (const TileFlagRule & rule : m_tile_flag_rules) {
+        auto gid_flags = evaluate_tile_flag(rule, tileset_ptrs, *property_keys);
+        for (TileLayer * tl : loaded_tile_layers)
+            tl->add_flag_plane(gid_flags, rule.keep_counts);
+    }
+
+    MapObjectStore loaded_objects(m_memory_resource);
+    for (const MapObjectStore & objects : group_objects)
+        loaded_objects.append(objects);
+    group_objects.clear();
+    MapObjectIndex loaded_object_index(
+        loaded_objects, sf::Vector2f(float(tile_width), float(tile_height)));
+    auto lazy_views = std::make_unique<LazyObjectViews>();
+    if (options.preprocess_object_geometry) {
+        // made through the flag, so that it is never made again
+        std::call_once(lazy_views->geometry_made, [&lazy_views, &loaded_objects]
+            { ObjectGeometry(loaded_objects).swap(lazy_views->geometry); });
+    }
 
     m_layers.reserve(loaded_layers.size());
 
@@ -230,6 +313,11 @@ void TiledMapImpl::load_from_file(const char * filename) {
     m_tile_width  = tile_width ;
     m_tile_height = tile_height;
     m_tile_sets.swap(tileset_ptrs);
+    m_property_keys.swap(property_keys);
+    m_object_store.swap(loaded_objects);
+    m_object_index.swap(loaded_object_index);
+    // made again from the store, if asked for
+    m_lazy_views.swap(lazy_views);
 }
 
 void TiledMapImpl::set_translation(const sf::Vector2f & offset) {
@@ -265,12 +353,61 @@ TilePropertiesInterface * TiledMapImpl::find_tile_layer(const std::string & name
     return const_cast<TilePropertiesInterface *>(cthis.find_tile_layer(name));
 }
 
+PropertyKey TiledMapImpl::property_key(const std::string & name) const {
+    if (!m_property_keys) return PropertyKey();
+    return m_property_keys->find(name);
+}
+
+TileFlag TiledMapImpl::register_tile_flag(const TileFlagRule & rule) {
+    auto layers = tile_layers();
+    if (!layers.empty()) {
+        assert(m_property_keys);
+        auto gid_flags = evaluate_tile_flag(rule, m_tile_sets, *m_property_keys);
+        for (TileLayer * tl : layers)
+            tl->add_flag_plane(gid_flags, rule.keep_counts);
+    }
+    m_tile_flag_rules.push_back(rule);
+    return TileFlagPlanes::make_flag(m_tile_flag_rules.size() - 1);
+}
+
+void TiledMapImpl::enable_flag_counts(TileFlag flag) {
+    if (!flag.is_valid() ||
+        TileFlagPlanes::index_of(flag) >= m_tile_flag_rules.size())
+    {
+        throw Error("TiledMapImpl::enable_flag_counts: flag was not "
+                    "registered with this map.");
+    }
+    for (TileLayer * tl : tile_layers())
+        tl->enable_flag_counts(flag);
+    m_tile_flag_rules[TileFlagPlanes::index_of(flag)].keep_counts = true;
+}
+
+void TiledMapImpl::compact_tile_layers() {
+    for (TileLayer * tl : tile_layers())
+        tl->compact_storage();
+}
+
 const TiledMapImpl::PropertyMap & TiledMapImpl::map_properties() const {
     return m_whole_map_properties;
 }
 
 const TiledMapImpl::MapObjectContainer & TiledMapImpl::map_objects() const {
-    return m_map_objects;
+    LazyObjectViews & views = *m_lazy_views;
+    std::call_once(views.map_objects_made, [this, &views] {
+        MapObjectContainer objects;
+        objects.reserve(m_object_store.size());
+        for (const MapObjectView & view : m_object_store)
+            objects.emplace_back(view.to_map_object());
+        views.map_objects.swap(objects);
+    });
+    return views.map_objects;
+}
+
+const ObjectGeometry & TiledMapImpl::object_geometry() const {
+    LazyObjectViews & views = *m_lazy_views;
+    std::call_once(views.geometry_made, [this, &views]
+        { ObjectGeometry(m_object_store).swap(views.geometry); });
+    return views.geometry;
 }
 
 MapLayerIter TiledMapImpl::begin() { return m_drawable_layers.begin(); }
@@ -336,16 +473,30 @@ TiledMapImpl::IterValuePair TiledMapImpl::find_tile_effect_ref_and_name
 ConstTileSetPtr TiledMapImpl::get_tile_set_for_gid(int gid) const noexcept
     { return find_tile_set_for_gid(m_tile_sets, gid); }
 
-/* private */ void TiledMapImpl::load_map_objects
-    (const TiXmlElement * map_el, const TileSetPtrVector & tilesets)
+int TiledMapImpl::end_gid() const noexcept {
+    // tile sets are kept sorted by gid
+    if (m_tile_sets.empty()) return 1;
+    return m_tile_sets.back()->end_gid();
+}
+
+/* private */ std::vector<TileLayer *> TiledMapImpl::tile_layers() {
+    std::vector<TileLayer *> rv;
+    for (const auto & layer : m_layers) {
+        if (auto * tl = dynamic_cast<TileLayer *>(layer.get()))
+            rv.push_back(tl);
+    }
+    return rv;
+}
+
+/* private static */ void TiledMapImpl::load_map_object_group
+    (const TiXmlElement * group_el, const TileSetPtrVector & tilesets,
+     MapObjectStore & objects)
 {
-    for (const TiXmlElement & obj_group : XmlRange(map_el, "objectgroup")) {
-        for (const TiXmlElement & obj : XmlRange(obj_group, "object")) {
-            MapObject mobj;
-            load_map_object_properties(&obj, tilesets, mobj);
-            m_map_objects.push_back(MapObject());
-            mobj.swap(m_map_objects.back());
-        }
+    const char * group_name = group_el->Attribute("name");
+    objects.add_group(group_name ? group_name : "");
+    for (const TiXmlElement & obj : XmlRange(group_el, "object")) {
+        objects.add_object();
+        load_map_object_properties(&obj, tilesets, objects);
     }
 }
 
@@ -353,13 +504,14 @@ ConstTileSetPtr TiledMapImpl::get_tile_set_for_gid(int gid) const noexcept
 
 namespace {
 
-void load_map_object_common_properties(const tinyxml2::XMLElement * el, MapObject & obj);
+void load_map_object_common_properties
+    (const tinyxml2::XMLElement * el, MapObjectStore & store);
 
 bool check_and_load_map_object_gid
     (const tinyxml2::XMLElement * el, const TileSetPtrVector & tilesets,
-     MapObject & obj);
+     MapObjectStore & store);
 
-void load_map_object_shape(const tinyxml2::XMLElement * el, MapObject & obj);
+void load_map_object_shape(const tinyxml2::XMLElement * el, MapObjectStore & store);
 
 sf::Color read_color_from(const TiXmlElement * el, const char * attr_name) {
     using UInt8 = sf::Uint8;
@@ -401,14 +553,14 @@ void load_whole_map_properties(const TiXmlElement * el, PropertyMap & map) {
 
 void load_map_object_properties
     (const tinyxml2::XMLElement * el, const TileSetPtrVector & tilesets,
-     MapObject & obj)
+     MapObjectStore & store)
 {
     assert(::strcmp("object", el->Value()) == 0);
 
-    load_map_object_common_properties(el, obj);
-    bool has_gid = check_and_load_map_object_gid(el, tilesets, obj);
-    load_map_object_shape(el, obj);
-    if (obj.shape_type != MapObject::k_rectangle && has_gid) {
+    load_map_object_common_properties(el, store);
+    bool has_gid = check_and_load_map_object_gid(el, tilesets, store);
+    load_map_object_shape(el, store);
+    if (store[store.size() - 1].shape_type() != MapObject::k_rectangle && has_gid) {
         throw Error("load_map_object_properties: map object cannot be "
                     "non-rectangular and have a gid associated with it.");
     }
@@ -425,12 +577,11 @@ TileSetPtr find_tile_set_for_gid(const TileSetPtrVector & tilesets, int gid) noe
 
 // ----------------------------------------------------------------------------
 
-void set_optional_builtin_attr(std::string & str, const char * cstr);
-
-MapObject::PointVector read_points(const tinyxml2::XMLElement *);
+/** Reads a polygon's or polyline's points into the last object. */
+void read_points(const tinyxml2::XMLElement *, MapObjectStore &);
 
 void load_map_object_common_properties
-    (const tinyxml2::XMLElement * el, MapObject & obj)
+    (const tinyxml2::XMLElement * el, MapObjectStore & store)
 {
     sf::Rect<float> bounds;
 
@@ -443,24 +594,23 @@ void load_map_object_common_properties
         throw Error("The width and height of a map object may not be negative");
     }
 
-    obj.bounds = bounds;
-    set_optional_builtin_attr(obj.name, el->Attribute("name"));
-    set_optional_builtin_attr(obj.type, el->Attribute("type"));
+    store.set_bounds(bounds);
+    if (const char * name = el->Attribute("name")) store.set_name(name);
+    if (const char * type = el->Attribute("type")) store.set_type(type);
 
-    obj.custom_properties.clear();
     for (const TiXmlElement & pel : XmlRange(el, "properties")) {
         for (const TiXmlElement & ppel : XmlRange(pel, "property")) {
             const char * name  = ppel.Attribute("name" );
             const char * value = ppel.Attribute("value");
             if (!name || !value) continue;
-            obj.custom_properties.insert({ name, value });
+            store.add_property(name, value);
         }
     }
 }
 
 bool check_and_load_map_object_gid
     (const tinyxml2::XMLElement * el, const TileSetPtrVector & tilesets,
-     MapObject & obj)
+     MapObjectStore & store)
 {
     int gid = 0;
     if (el->QueryIntAttribute("gid", &gid) != tinyxml2::XML_SUCCESS)
@@ -481,18 +631,21 @@ bool check_and_load_map_object_gid
         throw Error(k_gid_not_found);
     }
     assert(tileset.begin_gid() <= gid && tileset.end_gid() > gid);
-    obj.local_tile_id = gid - tileset.begin_gid();
-    obj.tile_set = tileset_ptr;
+    const int local_tile_id = gid - tileset.begin_gid();
+    store.set_tile(tileset_ptr, local_tile_id);
+    const auto obj = store[store.size() - 1];
     // TilEd is weird here, the y position starts at the bottom of the object
     // I want to make it one-to-one with how it appears in the editor
-    obj.bounds.top -= obj.bounds.height;
+    sf::FloatRect bounds = obj.bounds();
+    bounds.top -= bounds.height;
+    store.set_bounds(bounds);
 
-    if (obj.type.empty())
-        obj.type = tileset.type_of(obj.local_tile_id);
+    if (obj.type().empty())
+        store.set_type(tileset.type_of(local_tile_id));
     return true;
 }
 
-void load_map_object_shape(const tinyxml2::XMLElement * el, MapObject & obj) {
+void load_map_object_shape(const tinyxml2::XMLElement * el, MapObjectStore & store) {
     auto * polygon_el  = el->FirstChildElement("polygon" );
     auto * ellipse_el  = el->FirstChildElement("ellipse" );
     auto * polyline_el = el->FirstChildElement("polyline");
@@ -509,18 +662,19 @@ void load_map_object_shape(const tinyxml2::XMLElement * el, MapObject & obj) {
             any_set = true;
         }
     }
+    const sf::FloatRect & bounds = store[store.size() - 1].bounds();
     if (polygon_el) {
-        obj.shape_type = MapObject::k_polygon;
-        obj.points = read_points(polygon_el);
+        store.set_shape_type(MapObject::k_polygon);
+        read_points(polygon_el, store);
     } else if (ellipse_el) {
-        obj.shape_type = MapObject::k_ellipse;
+        store.set_shape_type(MapObject::k_ellipse);
     } else if (polyline_el) {
-        obj.shape_type = MapObject::k_polyline;
-        obj.points = read_points(polyline_el);
+        store.set_shape_type(MapObject::k_polyline);
+        read_points(polyline_el, store);
     } else if (text_el) {
-        obj.shape_type = MapObject::k_text;
-    } else if (obj.bounds.width != 0.f && obj.bounds.height != 0.f) {
-        obj.shape_type = MapObject::k_rectangle;
+        store.set_shape_type(MapObject::k_text);
+    } else if (bounds.width != 0.f && bounds.height != 0.f) {
+        store.set_shape_type(MapObject::k_rectangle);
     }
 }
 
@@ -529,20 +683,15 @@ void load_map_object_shape(const tinyxml2::XMLElement * el, MapObject & obj) {
 inline bool is_space(char c) { return c == ' '; }
 inline bool is_comma(char c) { return c == ','; }
 
-void set_optional_builtin_attr(std::string & str, const char * cstr)
-    { str = (cstr) ? cstr : ""; }
-
-MapObject::PointVector read_points(const tinyxml2::XMLElement * el) {
-    MapObject::PointVector points;
-
+void read_points(const tinyxml2::XMLElement * el, MapObjectStore & store) {
     const char * point_string = el->Attribute("points");
-    if (!point_string) return points;
+    if (!point_string) return;
 
     auto pt_str_end = point_string + ::strlen(point_string);
-    points.reserve(std::size_t((pt_str_end - point_string) / 3));
+    store.reserve_points(std::size_t((pt_str_end - point_string) / 3));
 
     for_split<is_space>(point_string, pt_str_end,
-                        [&points](const char * beg, const char * end)
+                        [&store](const char * beg, const char * end)
     {
         static constexpr const char * const k_exactly_two_msg =
             "MapObject tuples must have exactly two numbers.";
@@ -561,9 +710,34 @@ MapObject::PointVector read_points(const tinyxml2::XMLElement * el) {
             }
         });
         if (itr != end_list) throw Error(k_exactly_two_msg);
-        points.push_back(v);
+        store.add_point(v);
     });
-    return points;
+}
+
+GidFlagsPtr evaluate_tile_flag
+    (const TileFlagRule & rule, const TileSetPtrVector & tilesets,
+     const tmap::PropertyKeyTable & property_keys)
+{
+    const int end_gid = tilesets.empty() ? 1 : tilesets.back()->end_gid();
+    std::vector<bool> flags(std::size_t(end_gid), false);
+    if (rule.kind == TileFlagRule::k_gid_in_set) {
+        for (int gid : rule.gids) {
+            if (gid > 0 && gid < end_gid) flags[std::size_t(gid)] = true;
+        }
+        return std::make_shared<const tmap::GidFlags>(std::move(flags));
+    }
+
+    const bool compare_value = (rule.kind == TileFlagRule::k_property_equals);
+    const auto key = property_keys.find(rule.property_name);
+    if (key.is_valid()) {
+        for (const TileSetPtr & tset : tilesets) {
+        for (int gid = tset->begin_gid(); gid != tset->end_gid(); ++gid) {
+            const auto * value = tset->find_property(gid - tset->begin_gid(), key);
+            flags[std::size_t(gid)] =
+                value && (!compare_value || *value == rule.value);
+        }}
+    }
+    return std::make_shared<const tmap::GidFlags>(std::move(flags));
 }
 
 } // end of <anonymous> namespace
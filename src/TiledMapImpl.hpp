@@ -32,12 +32,15 @@
 #include <tmap/TiledMap.hpp>
 
 #include "TiXmlHelpers.hpp"
+#include "MapObjectIndex.hpp"
 
 #include <map>
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 
 namespace sf {
     class RenderTarget;
@@ -47,7 +50,9 @@ namespace sf {
 namespace tmap {
 
 class TileSet;
+class TileLayer;
 class MapLayer;
+class PropertyKeyTable;
 
 class TiledMapImpl {
 public:
@@ -59,11 +64,23 @@ public:
     using ConstTileSetPtr    = std::shared_ptr<const TileSetInterface>;
     using TileSetPtrVector   = std::vector<TileSetPtr>;
 
-    TiledMapImpl();
+    /** What a registered tile flag tests for. */
+    struct TileFlagRule {
+        enum Kind { k_has_property, k_property_equals, k_gid_in_set };
+
+        Kind kind = k_has_property;
+        std::string property_name;
+        std::string value;
+        std::vector<int> gids;
+        // if true every tile layer keeps a summed-area table for the flag
+        bool keep_counts = false;
+    };
+
+    explicit TiledMapImpl(std::pmr::memory_resource *);
 
     ~TiledMapImpl();
 
-    void load_from_file(const char * filename);
+    void load_from_file(const char * filename, const MapLoadOptions &);
 
     void set_translation(const sf::Vector2f & offset);
 
@@ -74,10 +91,24 @@ public:
 
     TilePropertiesInterface * find_tile_layer(const std::string & name);
 
+    PropertyKey property_key(const std::string & name) const;
+
+    TileFlag register_tile_flag(const TileFlagRule &);
+
+    void enable_flag_counts(TileFlag);
+
+    void compact_tile_layers();
+
     const PropertyMap & map_properties() const;
 
     const MapObjectContainer & map_objects() const;
 
+    const MapObjectStore & map_object_store() const { return m_object_store; }
+
+    const MapObjectIndex & object_index() const { return m_object_index; }
+
+    const ObjectGeometry & object_geometry() const;
+
     MapLayerIter begin();
 
     MapLayerIter end();
@@ -106,6 +137,12 @@ public:
 
     ConstTileSetPtr get_tile_set_for_gid(int gid) const noexcept;
 
+    int end_gid() const noexcept;
+
+    // tables are kept across loads, TiledMap rebuilds them
+    std::vector<std::unique_ptr<TilePropertyTableBase>> & tile_property_tables()
+        { return m_tile_property_tables; }
+
 private:
     using MapLayerContainer = std::vector<std::unique_ptr<MapLayer>>;
     using MapLayerMap = std::unordered_multimap<std::string, typename TiledMap::MapLayerIter>;
@@ -116,7 +153,14 @@ private:
     TiledMapImpl & operator = (const TiledMapImpl &) = delete;
     TiledMapImpl & operator = (TiledMapImpl &&) = delete;
 
-    void load_map_objects(const TiXmlElement * map_el, const TileSetPtrVector &);
+    /** Loads objects of one object group, adding them after those already
+     *  in the store.
+     */
+    static void load_map_object_group
+        (const TiXmlElement * group_el, const TileSetPtrVector &,
+         MapObjectStore & objects);
+
+    std::vector<TileLayer *> tile_layers();
 
     template <bool k_tf_val, typename A, typename B>
     struct TypeSelect { using Type = A; };
@@ -162,8 +206,29 @@ private:
     TilePropertiesInterface * m_ground_layer;
     PropertyMap m_whole_map_properties;
 
-    MapObjectContainer m_map_objects;
+    // tile matrices and objects are allocated from here
+    std::pmr::memory_resource * m_memory_resource;
+
+    MapObjectStore m_object_store;
+    MapObjectIndex m_object_index;
+    // made from the store the first time they are asked for (after each
+    // load), call_once keeps this safe for any number of reading threads;
+    // a new one is made by each load, as flags cannot be reset
+    // (geometry is made at load instead, if preprocessing was asked for)
+    struct LazyObjectViews {
+        std::once_flag map_objects_made;
+        MapObjectContainer map_objects;
+        std::once_flag geometry_made;
+        ObjectGeometry geometry;
+    };
+    std::unique_ptr<LazyObjectViews> m_lazy_views;
     TileSetPtrVector m_tile_sets;
+    // shared with (and kept alive by) tilesets
+    std::shared_ptr<PropertyKeyTable> m_property_keys;
+
+    std::vector<std::unique_ptr<TilePropertyTableBase>> m_tile_property_tables;
+    // kept across loads, each tile layer has a bit plane for each rule
+    std::vector<TileFlagRule> m_tile_flag_rules;
 
 };
 
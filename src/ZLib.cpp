@@ -29,11 +29,17 @@
 #include <vector>
 #include <stdexcept>
 #include <fstream>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <array>
+#include <thread>
 
 #include <common/TypeList.hpp>
 
+#include "Parallel.hpp"
+
 #include <cstddef>
-#include <cassert>
 
 #define ZLIB_CONST
 #define ZLIB_WINAPI
@@ -45,18 +51,11 @@ namespace {
 
 using namespace ZLib;
 
-void save_to_vector(UInt8 * buf, const std::size_t BUF_SIZE, ByteBuffer & data)
-    { data.insert(data.end(), buf, buf + BUF_SIZE); }
-
 const std::size_t TEMP_BUF_SIZE = 16384;
 
 const char * const FAILED_TO_INIT_ZLIB_STATE_MSG =
     "Failed to initialize ZLib state.";
 
-const char * const SHOULD_BE_UNREACHABLE_MSG =
-    "flow control has reached an 'unreachable' segment of code, this is the "
-    "programmer's fault, tell them about this error message.";
-
 } // end of <anonymous> namespace
 
 //
@@ -67,74 +66,158 @@ namespace {
 
 void zlib_inflate_init(z_stream & strm);
 
-class ZInflateRaii {
-public:
-    explicit ZInflateRaii(z_stream & strm): m_strm(&strm) {}
-    ~ZInflateRaii() { (void)inflateEnd(m_strm); }
-private:
-    z_stream * m_strm;
-};
+/** Feeds input to the inflater until its stream finishes, its output
+ *  fills, or it can make no further progress (the input is spent).
+ */
+void inflate_until_stuck
+    (Inflater & inflater, const UInt8 *& beg, const UInt8 * end);
+
+template <typename T>
+T clamp_to_zlib_size(std::size_t size);
+
+const char * const DATA_ENDS_EARLY_MSG =
+    "ZLib::decompress: compressed data ends before its stream does.";
 
 } // end of <anonymous> namespace
 
 namespace ZLib {
 
-ByteBuffer decompress(const ByteBuffer & src_data, ByteBuffer & cache_data) {
+ByteBuffer decompress(const ByteBuffer & src_data, ByteBuffer & cache_data)
+    { return decompress(src_data.data(), src_data.size(), cache_data); }
+
+ByteBuffer decompress
+    (const UInt8 * src_data, std::size_t src_size, ByteBuffer & cache_data)
+{
     ByteBuffer out_data;
     out_data.swap(cache_data);
-    out_data.clear();
 
-    UInt8 output_buffer[TEMP_BUF_SIZE];
+    // start with all the cache's memory, or a guess at the compression ratio,
+    // and inflate straight into the vector, doubling it as it fills
+    out_data.resize(std::max(out_data.capacity(),
+                             std::max(src_size*4, TEMP_BUF_SIZE)));
 
-    // inflation state information
-    z_stream strm;
-    ZInflateRaii strm_ender(strm); (void)strm_ender; // keep g++ happy
+    Inflater inflater;
+    inflater.set_output(out_data.data(), out_data.size());
+    const UInt8 * src_beg = src_data;
+    const UInt8 * src_end = src_beg + src_size;
+    while (true) {
+        inflate_until_stuck(inflater, src_beg, src_end);
+        if (inflater.finished()) break;
+        if (inflater.output_remaining() != 0)
+            throw Error(DATA_ENDS_EARLY_MSG);
+
+        const std::size_t written = out_data.size();
+        out_data.resize(written*2);
+        inflater.set_output(out_data.data() + written, written);
+    }
+    out_data.resize(out_data.size() - inflater.output_remaining());
+    return out_data;
+}
+
+ByteBuffer decompress(const ByteBuffer & src_data) {
+    ByteBuffer blank_vec;
+    return decompress(src_data, blank_vec);
+}
+
+std::size_t decompress
+    (const UInt8 * src, std::size_t src_size,
+     UInt8 * out, std::size_t out_capacity)
+{
+    Inflater inflater;
+    inflater.set_output(out, out_capacity);
+    const UInt8 * src_end = src + src_size;
+    inflate_until_stuck(inflater, src, src_end);
+    const std::size_t written = out_capacity - inflater.output_remaining();
+    if (inflater.finished()) return written;
+    if (inflater.output_remaining() != 0)
+        throw Error(DATA_ENDS_EARLY_MSG);
+
+    // the output is full, but the stream may yet end without another byte
+    UInt8 extra_byte;
+    inflater.set_output(&extra_byte, 1);
+    inflate_until_stuck(inflater, src, src_end);
+    if (inflater.output_remaining() == 0) {
+        throw Error("ZLib::decompress: inflated data does not fit in " +
+                    std::to_string(out_capacity) + " bytes.");
+    } else if (!inflater.finished()) {
+        throw Error(DATA_ENDS_EARLY_MSG);
+    }
+    return written;
+}
 
-    strm.avail_out = TEMP_BUF_SIZE;
-    strm.next_out  = output_buffer;
+/* static */ constexpr const std::size_t Inflater::k_default_chunk_size;
 
-    zlib_inflate_init(strm);
+Inflater::Inflater(std::size_t chunk_size):
+    m_strm(std::make_unique<z_stream>()),
+    m_chunk_size(std::max(chunk_size, std::size_t(1)))
+{
+    zlib_inflate_init(*m_strm);
+    m_strm->avail_out = 0;
+    m_strm->next_out  = Z_NULL;
+}
 
-    strm.avail_in = static_cast<decltype(strm.avail_in)>(src_data.size());
-    strm.next_in = static_cast<const Bytef *>(src_data.data());
+Inflater::~Inflater() { (void)inflateEnd(m_strm.get()); }
 
-    while (true) {
-        // inflate until out of buffer space
-        do {
-            switch (inflate(&strm, Z_NO_FLUSH)) {
-            case Z_OK: break;
-            case Z_STREAM_END:
-                save_to_vector(output_buffer, strm.total_out, out_data);
-                return out_data;
-            case Z_STREAM_ERROR:
-                // state not clobbered, "stack corruption"
-                throw Error("ZLib Decompression State is clobbered infrom the "
-                            "developer.");
-            case Z_NEED_DICT:
-                // consider this an error, this is not handled
-                throw Error("ZLib needs a dictionary, you must use more "
-                            "advanced functions in order to use this feature.");
-            case Z_DATA_ERROR: case Z_MEM_ERROR: default:
-                throw Error(std::string("ZLib::decompress error occured: \"") +
-                            strm.msg + std::string("\"."));
-            }
-        }
-        while (strm.avail_out != 0);
+void Inflater::set_output(UInt8 * out, std::size_t out_size) {
+    m_strm->avail_out =
+        clamp_to_zlib_size<decltype(m_strm->avail_out)>(out_size);
+    m_strm->next_out  = out;
+    m_output_beyond   = out_size - m_strm->avail_out;
+}
 
-        // out of space, reallocate
-        save_to_vector(output_buffer, strm.total_out, out_data);
-        strm.avail_out = TEMP_BUF_SIZE;
-        strm.next_out  = output_buffer;
-        strm.total_out = 0;
+std::size_t Inflater::inflate(const UInt8 * in, std::size_t in_size) {
+    top_up_output();
+    if (m_finished || m_strm->avail_out == 0) return 0;
+    m_strm->avail_in =
+        clamp_to_zlib_size<decltype(m_strm->avail_in)>(in_size);
+    m_strm->next_in  = static_cast<const Bytef *>(in);
+    const std::size_t given = m_strm->avail_in;
+    switch (::inflate(m_strm.get(), Z_NO_FLUSH)) {
+    case Z_OK: break;
+    case Z_STREAM_END:
+        m_finished = true;
+        break;
+    case Z_BUF_ERROR:
+        // no progress was possible, more input or output space is needed
+        break;
+    case Z_NEED_DICT:
+        throw Error("ZLib needs a dictionary, you must use more "
+                    "advanced functions in order to use this feature.");
+    case Z_STREAM_ERROR: case Z_DATA_ERROR: case Z_MEM_ERROR: default:
+        throw Error(std::string("ZLib::Inflater::inflate error occured: \"") +
+                    (m_strm->msg ? m_strm->msg : "") + std::string("\"."));
     }
-    // cannot return here, loop never breaks, return points inside
-    assert(false);
-    throw Error(std::string("ZLib::decompress ") + SHOULD_BE_UNREACHABLE_MSG);
+    const std::size_t consumed = given - m_strm->avail_in;
+    m_strm->avail_in = 0;
+    m_strm->next_in  = Z_NULL;
+    return consumed;
 }
 
-ByteBuffer decompress(const ByteBuffer & src_data) {
-    ByteBuffer blank_vec;
-    return decompress(src_data, blank_vec);
+Inflater::OutputChunk Inflater::inflate_chunk
+    (const UInt8 *& in, const UInt8 * in_end)
+{
+    m_chunk.resize(m_chunk_size);
+    set_output(m_chunk.data(), m_chunk.size());
+    inflate_until_stuck(*this, in, in_end);
+
+    OutputChunk rv;
+    rv.data = m_chunk.data();
+    rv.size = m_chunk.size() - output_remaining();
+    return rv;
+}
+
+std::size_t Inflater::output_remaining() const
+    { return m_strm->avail_out + m_output_beyond; }
+
+/* private */ void Inflater::top_up_output() {
+    // next_out has moved past what was written, so what is beyond simply
+    // follows on from the current avail_out
+    using ZLibSize = decltype(m_strm->avail_out);
+    const std::size_t room =
+        std::size_t(std::numeric_limits<ZLibSize>::max()) - m_strm->avail_out;
+    const std::size_t added = std::min(room, m_output_beyond);
+    m_strm->avail_out += static_cast<ZLibSize>(added);
+    m_output_beyond   -= added;
 }
 
 } // end of ZLib namespace
@@ -149,11 +232,33 @@ void zlib_inflate_init(z_stream & strm) {
     strm.avail_in = 0;
     strm.next_in = Z_NULL;
 
-    int ret = inflateInit(&strm);
+    // window bits of 15, plus 32 to accept either a ZLib or gzip header
+    int ret = inflateInit2(&strm, 15 + 32);
     if (ret != Z_OK)
         throw Error(FAILED_TO_INIT_ZLIB_STATE_MSG);
 }
 
+void inflate_until_stuck
+    (Inflater & inflater, const UInt8 *& beg, const UInt8 * end)
+{
+    while (!inflater.finished() && inflater.output_remaining() != 0) {
+        const std::size_t remaining = inflater.output_remaining();
+        const std::size_t consumed  =
+            inflater.inflate(beg, static_cast<std::size_t>(end - beg));
+        beg += consumed;
+        if (consumed == 0 && remaining == inflater.output_remaining()) return;
+    }
+}
+
+template <typename T>
+T clamp_to_zlib_size(std::size_t size) {
+    // ZLib counts in (usually 32-bit) unsigned ints, larger input is taken
+    // over more calls, and larger output topped up as it fills
+    static constexpr const std::size_t k_max =
+        std::numeric_limits<T>::max();
+    return static_cast<T>(std::min(size, k_max));
+}
+
 } // end of <anonymous> namespace
 
 //
@@ -162,7 +267,18 @@ void zlib_inflate_init(z_stream & strm) {
 
 namespace {
 
-void zlib_deflate_init(z_stream & strm, ZLib::CompressionLevel level);
+/** Deflates one block of a parallel compressed stream as raw deflate data.
+ *  Every block but the last ends on a byte boundary (by way of a sync
+ *  flush), so that blocks may simply be laid one after another.
+ *  @param dict input just before the block, used to prime the window
+ */
+void deflate_block
+    (const UInt8 * dict, std::size_t dict_size,
+     const UInt8 * src, std::size_t src_size,
+     CompressionLevel level, bool is_last, ByteBuffer & out);
+
+/** @return the two byte header of a ZLib stream compressed at level */
+std::array<UInt8, 2> make_zlib_header(CompressionLevel level);
 
 class ZDeflateRaii {
 public:
@@ -172,75 +288,85 @@ private:
     z_stream * m_strm;
 };
 
+// size of deflate's window, how far back a block may look into the last
+const std::size_t k_window_size = 32768;
+
+// blocks are handed to ZLib whole, which counts in 32-bit ints
+const std::size_t k_max_block_size = std::size_t(1) << 30;
+
 } // end of <anonymous> namespace
 
 namespace ZLib {
 
+void compress
+    (const UInt8 * src, std::size_t src_size, CompressionLevel level,
+     const OutputSink & sink, const CompressOptions & options)
+{
+    const std::size_t block_size =
+        std::min(std::max(options.block_size, std::size_t(1)),
+                 k_max_block_size);
+    // an empty input still needs its (empty) final block
+    const std::size_t block_count =
+        std::max(std::size_t(1), (src_size + block_size - 1) / block_size);
+    const std::size_t max_threads = options.max_threads != 0 ?
+        options.max_threads : std::size_t(std::thread::hardware_concurrency());
+    // compressed blocks are assumed to be no bigger than their input, which
+    // holds but for incompressible data (where it is nearly so)
+    const std::size_t batch_size = std::min(block_count,
+        std::max(std::size_t(1), options.memory_budget / block_size));
+
+    const auto header = make_zlib_header(level);
+    sink(header.data(), header.size());
+
+    std::vector<ByteBuffer> blocks(batch_size);
+    std::vector<uLong> checksums(batch_size);
+    uLong checksum = adler32(0L, Z_NULL, 0);
+    for (std::size_t batch_beg = 0; batch_beg < block_count;
+         batch_beg += batch_size)
+    {
+        const std::size_t batch_end =
+            std::min(block_count, batch_beg + batch_size);
+        tmap::parallel_for(batch_end - batch_beg, max_threads,
+            [&](std::size_t i)
+        {
+            const std::size_t block_beg  = (batch_beg + i)*block_size;
+            const std::size_t block_len  =
+                std::min(block_size, src_size - block_beg);
+            const std::size_t dict_size = std::min(block_beg, k_window_size);
+            deflate_block(src + block_beg - dict_size, dict_size,
+                          src + block_beg, block_len, level,
+                          batch_beg + i + 1 == block_count, blocks[i]);
+            checksums[i] = adler32(adler32(0L, Z_NULL, 0), src + block_beg,
+                                   static_cast<uInt>(block_len));
+        });
+        for (std::size_t i = 0; i != batch_end - batch_beg; ++i) {
+            const std::size_t block_beg = (batch_beg + i)*block_size;
+            const std::size_t block_len =
+                std::min(block_size, src_size - block_beg);
+            sink(blocks[i].data(), blocks[i].size());
+            checksum = adler32_combine(checksum, checksums[i],
+                                       static_cast<z_off_t>(block_len));
+        }
+    }
+
+    // the stream ends with the Adler-32 of the whole input, big endian
+    const std::array<UInt8, 4> trailer = {
+        UInt8((checksum >> 24) & 0xFF), UInt8((checksum >> 16) & 0xFF),
+        UInt8((checksum >>  8) & 0xFF), UInt8( checksum        & 0xFF)
+    };
+    sink(trailer.data(), trailer.size());
+}
+
 ByteBuffer compress
     (const ByteBuffer & src, CompressionLevel level, ByteBuffer & cache_out)
 {
-    // I super apollogize for the long function!
     ByteBuffer data_out;
     cache_out.clear();
     data_out.swap(cache_out);
-
-    UInt8 output_buffer[TEMP_BUF_SIZE];
-
-    // initializes ZLib stream state
-    z_stream strm; // stream state
-    ZDeflateRaii strm_ender(strm); (void)strm_ender; // keep g++ happy
-    zlib_deflate_init(strm, level);
-
-    // now consider that the output memory runs out (ratio > 1, ew...)
-    // assume: will be done immediately after one go with decompression
-    int flush     = Z_NO_FLUSH;
-    strm.avail_in = static_cast<decltype(strm.avail_in)>(src.size());
-    strm.next_in  = static_cast<const Bytef *>(src.data());
-
-    strm.avail_out = TEMP_BUF_SIZE;
-    strm.next_out  = output_buffer;
-
-    while (true) {
-        bool need_more_buf = false;
-        switch (deflate(&strm, flush)) {
-        case Z_OK: break;
-        case Z_BUF_ERROR:
-            // not enough output is the only apporpiate case for which this
-            // condidtion should be met
-            need_more_buf = true;
-            if (strm.avail_out == TEMP_BUF_SIZE) {
-                // I'm really hoping this won't happen... but it probably will
-                throw Error("ZLib, temp output buffer too small!");
-            }
-            break;
-        case Z_STREAM_ERROR: // show stopper
-            throw Error(std::string("ZLib error: \"") + strm.msg +
-                        std::string("\"."));
-        case Z_STREAM_END:
-            save_to_vector(output_buffer, strm.total_out, data_out);
-            return data_out;
-        default:
-            throw Error(std::string("ZLib::compress ") +
-                        SHOULD_BE_UNREACHABLE_MSG);
-        }
-
-        if (need_more_buf || strm.avail_out == 0) {
-            // :TODO: is there a way to find out how much ZLib needs?
-            save_to_vector(output_buffer, strm.total_out, data_out);
-            // reset output buf
-            strm.avail_out = TEMP_BUF_SIZE;
-            strm.next_out  = output_buffer;
-            strm.total_out = 0;
-            need_more_buf = false;
-        }
-
-        // tell ZLib to finish if there is nothing left to process
-        if (strm.avail_in == 0)
-            flush = Z_FINISH;
-    }
-
-    assert(false);
-    throw Error(std::string("ZLib::compress ") + SHOULD_BE_UNREACHABLE_MSG);
+    compress(src.data(), src.size(), level,
+        [&data_out](const UInt8 * data, std::size_t size)
+        { data_out.insert(data_out.end(), data, data + size); });
+    return data_out;
 }
 
 ByteBuffer compress(const ByteBuffer & src, CompressionLevel level) {
@@ -252,13 +378,59 @@ ByteBuffer compress(const ByteBuffer & src, CompressionLevel level) {
 
 namespace {
 
-void zlib_deflate_init(z_stream & strm, ZLib::CompressionLevel level) {
+void deflate_block
+    (const UInt8 * dict, std::size_t dict_size,
+     const UInt8 * src, std::size_t src_size,
+     CompressionLevel level, bool is_last, ByteBuffer & out)
+{
+    z_stream strm;
     strm.zalloc = Z_NULL;
     strm.zfree  = Z_NULL;
     strm.opaque = Z_NULL;
-    int ret = deflateInit(&strm, static_cast<int>(level));
-    if (ret != Z_OK)
-        throw Error(FAILED_TO_INIT_ZLIB_STATE_MSG);
+    // negative window bits for raw deflate data, with no header or trailer
+    if (deflateInit2(&strm, static_cast<int>(level), Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    { throw Error(FAILED_TO_INIT_ZLIB_STATE_MSG); }
+    ZDeflateRaii strm_ender(strm); (void)strm_ender; // keep g++ happy
+
+    if (dict_size != 0 &&
+        deflateSetDictionary(&strm, dict, static_cast<uInt>(dict_size)) != Z_OK)
+    { throw Error("ZLib::compress: failed to set block dictionary."); }
+
+    strm.avail_in = static_cast<uInt>(src_size);
+    strm.next_in  = static_cast<const Bytef *>(src);
+
+    // the bound leaves out the few bytes of a sync flush's empty block
+    out.resize(deflateBound(&strm, static_cast<uLong>(src_size)) + 16);
+    const int flush = is_last ? Z_FINISH : Z_SYNC_FLUSH;
+    while (true) {
+        strm.avail_out = static_cast<uInt>(out.size() - strm.total_out);
+        strm.next_out  = out.data() + strm.total_out;
+        const int ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR) {
+            throw Error(std::string("ZLib::compress error occured: \"") +
+                        (strm.msg ? strm.msg : "") + std::string("\"."));
+        }
+        const bool done = is_last ? ret == Z_STREAM_END :
+                          strm.avail_in == 0 && strm.avail_out != 0;
+        if (done) break;
+        // should not happen given the bound, but more room is all it needs
+        out.resize(out.size()*2);
+    }
+    out.resize(strm.total_out);
+}
+
+std::array<UInt8, 2> make_zlib_header(CompressionLevel level) {
+    // compression method 8 (deflate), with a 32K window
+    const unsigned cmf = 0x78;
+    // the level hint, as ZLib itself gives it (default is level 6)
+    const int value = static_cast<int>(level);
+    const unsigned flevel = value < 0 ? 2 : value < 2 ? 0 :
+                            value < 6 ? 1 : value == 6 ? 2 : 3;
+    // check bits make the header a multiple of 31
+    unsigned flg = flevel << 6;
+    flg += 31 - ((cmf << 8) | flg) % 31;
+    return std::array<UInt8, 2> { UInt8(cmf), UInt8(flg) };
 }
 
 } // end of <anonymous> namespace
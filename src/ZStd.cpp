@@ -0,0 +1,169 @@
+/****************************************************************************
+
+    MIT License
+
+    Copyright (c) 2020 Aria Janke
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*****************************************************************************/
+
+
+#include <tmap/ZStd.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include <cassert>
+
+#ifdef MACRO_USE_ZSTD
+#   include <zstd.h>
+#endif
+
+using Error = std::runtime_error;
+
+namespace {
+
+using namespace ZStd;
+
+const std::size_t TEMP_BUF_SIZE = 16384;
+
+// little endian 0xFD2FB528
+const UInt8 k_magic_number[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+#ifndef MACRO_USE_ZSTD
+[[noreturn]] void throw_unsupported(const char * caller);
+#endif
+
+} // end of <anonymous> namespace
+
+namespace ZStd {
+
+bool is_supported() {
+#   ifdef MACRO_USE_ZSTD
+    return true;
+#   else
+    return false;
+#   endif
+}
+
+bool has_magic_number(const UInt8 * data, std::size_t size) {
+    if (size < sizeof(k_magic_number)) return false;
+    return std::equal(k_magic_number, k_magic_number + sizeof(k_magic_number), data);
+}
+
+ByteBuffer decompress(const ByteBuffer & src_data) {
+    ByteBuffer blank_vec;
+    return decompress(src_data, blank_vec);
+}
+
+ByteBuffer decompress(const ByteBuffer & src_data, ByteBuffer & cache_data)
+    { return decompress(src_data.data(), src_data.size(), cache_data); }
+
+ByteBuffer decompress
+    (const UInt8 * src_data, std::size_t src_size, ByteBuffer & cache_data)
+{
+    ByteBuffer out_data;
+    out_data.swap(cache_data);
+    out_data.clear();
+
+    Decompressor decompressor;
+    std::size_t consumed = 0;
+    while (!decompressor.finished()) {
+        const std::size_t old_size = out_data.size();
+        out_data.resize(old_size + TEMP_BUF_SIZE);
+        decompressor.set_output(out_data.data() + old_size, TEMP_BUF_SIZE);
+        while (!decompressor.finished() && decompressor.output_remaining() != 0) {
+            const std::size_t remaining = decompressor.output_remaining();
+            const std::size_t step = decompressor.decompress
+                (src_data + consumed, src_size - consumed);
+            consumed += step;
+            if (step == 0 && remaining == decompressor.output_remaining())
+                throw Error("ZStd::decompress: compressed data ends early.");
+        }
+        out_data.resize(out_data.size() - decompressor.output_remaining());
+    }
+    return out_data;
+}
+
+#ifdef MACRO_USE_ZSTD
+
+Decompressor::Decompressor():
+    m_context(ZSTD_createDCtx())
+{
+    if (!m_context)
+        throw Error("Failed to initialize ZStd state.");
+}
+
+Decompressor::~Decompressor() {}
+
+void Decompressor::set_output(UInt8 * out, std::size_t out_size) {
+    m_out      = out;
+    m_out_size = out_size;
+    m_out_pos  = 0;
+}
+
+std::size_t Decompressor::decompress(const UInt8 * in, std::size_t in_size) {
+    if (m_finished || output_remaining() == 0) return 0;
+    ZSTD_inBuffer  in_buf  = { in, in_size, 0 };
+    ZSTD_outBuffer out_buf = { m_out, m_out_size, m_out_pos };
+    const std::size_t rv = ZSTD_decompressStream(m_context.get(), &out_buf, &in_buf);
+    if (ZSTD_isError(rv)) {
+        throw Error(std::string("ZStd::Decompressor::decompress error occured: \"") +
+                    ZSTD_getErrorName(rv) + "\".");
+    }
+    m_out_pos = out_buf.pos;
+    // zero means the frame is done, and fully flushed
+    m_finished = (rv == 0);
+    return in_buf.pos;
+}
+
+void Decompressor::ContextDeleter::operator () (ZSTD_DCtx_s * context) const
+    { (void)ZSTD_freeDCtx(context); }
+
+#else
+
+Decompressor::Decompressor()
+    { throw_unsupported("Decompressor::Decompressor"); }
+
+Decompressor::~Decompressor() {}
+
+void Decompressor::set_output(UInt8 *, std::size_t)
+    { throw_unsupported("Decompressor::set_output"); }
+
+std::size_t Decompressor::decompress(const UInt8 *, std::size_t)
+    { throw_unsupported("Decompressor::decompress"); }
+
+void Decompressor::ContextDeleter::operator () (ZSTD_DCtx_s *) const {}
+
+#endif
+
+} // end of ZStd namespace
+
+#ifndef MACRO_USE_ZSTD
+namespace {
+
+[[noreturn]] void throw_unsupported(const char * caller) {
+    throw Error(std::string("ZStd::") + caller + ": tmap was built without "
+                "Zstandard support (define MACRO_USE_ZSTD and link libzstd).");
+}
+
+} // end of <anonymous> namespace
+#endif